@@ -1,56 +1,479 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
+#include <unistd.h>
+#include <getopt.h>
 #include <pthread.h>
+#include <errno.h>
+#include <limits.h>
 
 #include "barrier.h"
 #include "state_array.h"
+#include "value.h"
+#include "stencil.h"
+#include "report.h"
+#include "bench.h"
+#include "instrument.h"
+#include "wavefront.h"
+#include "tiled.h"
+#include "simd.h"
+#include "stream.h"
+#include "affinity.h"
+#include "alloc.h"
+#include "tune.h"
 
 // We'll use a "global" (really "static") variable for the result. This makes it easy to
 // access from the barrier function.
-int gResult = 0;
+value_t gResult = 0;
 
 
 
-// A struct for passing arguments to a thread function.
-typedef struct{
+// The control block of a thread: its arguments and counters. All of the blocks of a
+// computation are allocated together, in one arena, and each block starts on its own
+// cache line so that the counters of neighboring threads don't share one.
+typedef struct thread_function_args_tag{
 
     //int tid; // thread id -- useful for debugging
+    _Alignas(CACHE_LINE) state_array_t *sa; // the state array of this computation
     int s_index; // this thread's "home" location in the state array
+    int e_idx, s_idx, es_idx;         // the east, south, and south-east neighbors
 
     int numRounds; // how many times to repeat the wave
 	  barrier_t *barrier;
+
+    value_t *results;  // pipelined mode: where element 0 records the result of each round
+    int cpu;           // the CPU to pin this thread to, or -1 to leave it unpinned
+    cell_stats stats;  // this thread's instrumentation counters (see instrument.h)
+
+    // The threads are started as a binary tree (see spawnChildren()): thread t starts
+    // threads 2t + 1 and 2t + 2, which find their blocks in the arena.
+    int t_index;       // this thread's index in the arena and in thread_arr
+    int num_threads;   // the number of threads in the computation
+    pthread_t *threads;                 // thread_arr
+    struct thread_function_args_tag *arena;
+    void *(*fn)(void *);                // the thread function, doWork or doPipelinedWork
 } thread_function_args;
 
 
 
 // Function prototypes.
-int wavefront(int num_thread_rows, int num_thread_cols, int numRounds);
 void *doWork(void *a);
+void *doPipelinedWork(void *a);
 void * barrier_function(void * a);
+static void spawnChildren(const thread_function_args *args);
+static int runBatch(const char *path, const engine_opts *opts);
+static int parseInt(const char *s, int *value);
 
 /** Performs a very lightweight wavefront computation using threads, mutexes, and condition
  *  variables.
  *
- *  Usage: ./a3 nrows ncols reps
+ *  Usage: ./a3 [-e engine] [-t threads] [-b tile_rows[xtile_cols]] [-s] [-k barrier] [-a] [-G groups]
+ *              [-c | -C file] [-o file [-L layout]] [-r output]
+ *              nrows ncols reps [nrows ncols reps ...]
+ *         ./a3 [options] -q file
+ *         ./a3 bench [options]     (see bench.h)
  *      where nrows and ncols are the dimensions of the array, and
  *          nreps is the number of repetitions (or rounds). Each
- *          round is independent (and a duplicate) of the other rounds.
+ *          round is independent (and a duplicate) of the other rounds. Several
+ *          queries may be given; they run one after the other in the same context
+ *          (see wavefrontContextCreate()), so the tiled engine's workers are reused.
+ *
+ *      -e selects the engine: "cell" (one thread per element), "pipeline" (one
+ *          thread per element, with rounds overlapping instead of separated by a
+ *          barrier), "tiled" (a fixed pool of workers over tiles), "recursive" (a
+ *          pool of workers over quadrants, split down to leaves of -b elements),
+ *          "simd" (one thread sweeping anti-diagonals with vector adds), "stream" (one thread
+ *          sweeping rows, keeping only two of them in memory), "closed" (the
+ *          result from its closed form, in O(min(nrows, ncols)) time, without a
+ *          wavefront, in builds for the default stencil; see stencil.h), "gpu" (the
+ *          anti-diagonal sweep on a CUDA device, in builds made with "make GPU=1"), or
+ *          "auto" (the default, which picks the engine, thread count, and tile size
+ *          estimated to be fastest for each query; see tune.h).
+ *      -t sets the number of worker threads for the tiled and recursive engines.
+ *      -b sets the tile size for the tiled engine, or the leaf size for the recursive one.
+ *      -s prints per-worker scheduler stats (tasks, steals, idle time) to stderr.
+ *      -k selects the barrier used between rounds: "mutex" (the default), "sense",
+ *          "tree", or "dissemination" (see barrier.h).
+ *      -a pins the threads of the cell, pipeline, tiled, and recursive engines to CPUs
+ *          in NUMA node order, has each node first-touch its own band of rows, and
+ *          prints the mapping to stderr (see affinity.h).
+ *      -G splits the tiled engine's workers into that many groups, which run rounds
+ *          concurrently, each on its own state array (see groups.h). With more than one
+ *          group, the auto engine always runs the tiled engine, and the other engines
+ *          are rejected.
+ *      -q reads "nrows ncols" queries from a file ("-" for stdin) and answers them all
+ *          from one sweep at the largest shape (see wavefrontBatch()), printing
+ *          "nrows x ncols, result is X" for each.
+ *      -c caches results by shape, so a shape given more than once is computed once,
+ *          and rounds answered from the cache are printed with "(cached)".
+ *      -C is like -c, but keeps the cache in a file shared with other processes.
+ *      -o writes the final sums of the whole array to a binary file that other programs
+ *          can map (see grid_file.h), with the values in "rows" (row-major, the default)
+ *          or "diagonals" (anti-diagonal-major) order as set by -L. With several
+ *          queries, the file holds the last one.
+ *      -r selects how the rounds are printed: "lines" (one printf() per round, the
+ *          default), "buffered" (the same lines, written in large chunks), or "summary"
+ *          (one line per query with the number of rounds and their throughput, which
+ *          fails if any round's result differs from round 0's). See report.h.
+ *      -H selects the pages the state array is allocated on: "auto" (huge pages for
+ *          large arrays when the system has them, the default), "small", "thp"
+ *          (transparent huge pages), or "hugetlb" (the reserved huge page pool). See
+ *          alloc.h; -s reports what each array actually got.
+ *      --explain prints what the auto engine chose for each query, and the estimates it
+ *          compared, to stderr.
+ *      --tune-file sets the file that keeps the auto engine's calibration of this host
+ *          (see tuneDefaultPath()), and --retune calibrates again even if it exists.
  *
  */
 int main( int argc, char *argv[]){
 
-    if(argc != 4){
+    if(argc > 1 && strcmp(argv[1], "bench") == 0){
+        return benchMain(argc - 1, argv + 1);
+    }
+
+    engine_opts opts;
+    defaultEngineOpts(&opts);
+    const char *batch_path = NULL;
+    alloc_pages pages;
+    report_mode report = REPORT_LINES;
+    const char *tune_path = NULL;
+    int retune = 0;
+
+    // The options that only have a long form.
+    enum{ OPT_EXPLAIN = 256, OPT_TUNE_FILE, OPT_RETUNE };
+    static const struct option long_opts[] = {
+        { "explain", no_argument, NULL, OPT_EXPLAIN },
+        { "tune-file", required_argument, NULL, OPT_TUNE_FILE },
+        { "retune", no_argument, NULL, OPT_RETUNE },
+        { NULL, 0, NULL, 0 }
+    };
+
+    int opt;
+    while((opt = getopt_long(argc, argv, "e:t:b:sk:aG:q:cC:o:L:r:H:", long_opts, NULL)) != -1){
+
+        switch(opt){
+
+            case 'e':
+                if(engineFromName(optarg, &opts.engine) != 0){
+                    fprintf(stderr, "Unknown engine: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+
+            case 't':
+                if(parseInt(optarg, &opts.num_threads) != 0){
+                    fprintf(stderr, "Bad thread count: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+
+            case 'b':
+                if(sscanf(optarg, "%dx%d", &opts.tile_rows, &opts.tile_cols) < 1){
+                    fprintf(stderr, "Bad tile size: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+
+            case 's':
+                opts.stats = 1;
+                break;
+
+            case 'a':
+                opts.affinity = 1;
+                break;
+
+            case 'q':
+                batch_path = optarg;
+                break;
+
+            case 'c':
+                opts.cache = 1;
+                break;
+
+            case 'C':
+                opts.cache = 1;
+                opts.cache_file = optarg;
+                break;
+
+            case 'o':
+                opts.grid_file = optarg;
+                break;
+
+            case 'L':
+                if(gridLayoutFromName(optarg, &opts.layout) != 0){
+                    fprintf(stderr, "Unknown layout: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+
+            case 'r':
+                if(reportModeFromName(optarg, &report) != 0){
+                    fprintf(stderr, "Unknown output mode: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+
+            case 'H':
+                if(allocPagesFromName(optarg, &pages) != 0){
+                    fprintf(stderr, "Unknown page kind: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                allocSetPages(pages);
+                break;
+
+            case OPT_EXPLAIN:
+                opts.explain = 1;
+                break;
+
+            case OPT_TUNE_FILE:
+                tune_path = optarg;
+                break;
+
+            case OPT_RETUNE:
+                retune = 1;
+                break;
+
+            case 'G':
+                if(parseInt(optarg, &opts.groups) != 0 || opts.groups < 1){
+                    fprintf(stderr, "The number of groups must be at least 1\n");
+                    return EXIT_FAILURE;
+                }
+                break;
+
+            case 'k':
+                if(barrier_kind_from_name(optarg, &opts.barrier) != 0){
+                    fprintf(stderr, "Unknown barrier: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+
+            default:
+                printf("Usage: ./a3 [-e auto|cell|pipeline|tiled|recursive|simd|stream|closed] [-t threads] [-b tile_rows[xtile_cols]] [-s] [-k mutex|sense|tree|dissemination] [-a] [-G groups] [-q file] [-c | -C file] [-o file [-L rows|diagonals]] [-r lines|buffered|summary] [-H auto|small|thp|hugetlb] [--explain] [--tune-file file] [--retune] nrows ncols reps [nrows ncols reps ...]\n");
+                return EXIT_FAILURE;
+        }
+    }
+
+    // The profile is only loaded by the first query that needs it, but a recalibration
+    // runs here, before the output mode is set.
+    if(opts.engine == ENGINE_AUTO || retune){
+        tuneLoad(tune_path, retune, opts.explain);
+    }
+
+    reportMode(report);
+
+    if(batch_path != NULL && argc == optind){
+        return runBatch(batch_path, &opts);
+    }
 
-      printf("Usage: ./a3 nrows ncols reps\n");
+    if(argc - optind < 3 || (argc - optind) % 3 != 0){
+
+      printf("Usage: ./a3 [-e auto|cell|pipeline|tiled|recursive|simd|stream|closed] [-t threads] [-b tile_rows[xtile_cols]] [-s] [-k mutex|sense|tree|dissemination] [-a] [-G groups] [-q file] [-c | -C file] [-o file [-L rows|diagonals]] [-r lines|buffered|summary] [-H auto|small|thp|hugetlb] [--explain] [--tune-file file] [--retune] nrows ncols reps [nrows ncols reps ...]\n");
       return EXIT_FAILURE;
     }
 
-	int nrows = atoi(argv[1]);
-	int ncols = atoi(argv[2]);
-	int reps  = atoi(argv[3]);
+    // Size the context for the largest query, so that the queries after it reuse the
+    // same workers and state array.
+    int max_rows = 0, max_cols = 0;
+    for(int q=optind; q < argc; q += 3){
+
+        int nrows, ncols, reps;
+        if(parseInt(argv[q], &nrows) != 0 || parseInt(argv[q + 1], &ncols) != 0
+           || parseInt(argv[q + 2], &reps) != 0){
+            fprintf(stderr, "Bad query: %s %s %s\n", argv[q], argv[q + 1], argv[q + 2]);
+            return EXIT_FAILURE;
+        }
+        if(nrows > max_rows) max_rows = nrows;
+        if(ncols > max_cols) max_cols = ncols;
+    }
+
+    wavefront_context *ctx = wavefrontContextCreate(max_rows, max_cols, &opts);
+    if(ctx == NULL){
+        return EXIT_FAILURE;
+    }
+
+    int status = EXIT_SUCCESS;
+    for(int q=optind; q < argc && status == EXIT_SUCCESS; q += 3){
+
+	    // The queries were all checked above.
+	    int nrows, ncols, reps;
+	    parseInt(argv[q], &nrows);
+	    parseInt(argv[q + 1], &ncols);
+	    parseInt(argv[q + 2], &reps);
+
+	    status = wavefrontRun(ctx, nrows, ncols, reps, NULL);
+    }
+
+    if(wavefrontContextDestroy(ctx) != 0){
+        return EXIT_FAILURE;
+    }
+
+    return status;
+}
+
+
+
+/** Read "nrows ncols" pairs from a file (or stdin, for "-"), answer them all with
+ *  wavefrontBatch(), and print the results in the order of the queries.
+ *  @return 0 on success, or an error code
+ */
+/** Parse a whole argument as a decimal int.
+ *  @return 0 on success, or -1 if it isn't a number or doesn't fit in an int
+ */
+static int parseInt(const char *s, int *value){
+
+    char *end;
+    errno = 0;
+    long v = strtol(s, &end, 10);
+    if(end == s || *end != '\0' || errno != 0 || v < INT_MIN || v > INT_MAX){
+        return -1;
+    }
+
+    *value = (int) v;
+    return 0;
+}
+
+
+static int runBatch(const char *path, const engine_opts *opts){
+
+    FILE *in = stdin;
+    if(strcmp(path, "-") != 0 && (in = fopen(path, "r")) == NULL){
+        perror(path);
+        return EXIT_FAILURE;
+    }
+
+    int n = 0, cap = 64;
+    int *rows = malloc(cap * sizeof(int));
+    int *cols = malloc(cap * sizeof(int));
+    int r, c;
+
+    while(fscanf(in, "%d %d", &r, &c) == 2){
+
+        if(n == cap){
+            cap *= 2;
+            rows = realloc(rows, cap * sizeof(int));
+            cols = realloc(cols, cap * sizeof(int));
+        }
+        rows[n] = r;
+        cols[n] = c;
+        n++;
+    }
+
+    int status = EXIT_SUCCESS;
+    if(!feof(in)){
+        fprintf(stderr, "%s: expected \"nrows ncols\" pairs\n", path);
+        status = EXIT_FAILURE;
+    }
+    if(in != stdin){
+        fclose(in);
+    }
+
+    value_t *results = malloc((n > 0 ? n : 1) * sizeof(value_t));
+    wavefront_context *ctx = NULL;
+
+    if(status == EXIT_SUCCESS && n > 0){
+
+        ctx = wavefrontContextCreate(0, 0, opts);
+        if(ctx == NULL || wavefrontBatch(ctx, rows, cols, n, results) != 0){
+            fprintf(stderr, "%s: batch failed\n", path);
+            status = EXIT_FAILURE;
+        }
+    }
+
+    for(int q=0; q < n && status == EXIT_SUCCESS; q++){
+
+        char buf[VALUE_STR_LEN];
+        printf("%d x %d, result is %s\n", rows[q], cols[q], valueToString(results[q], buf));
+    }
+
+    if(ctx != NULL && wavefrontContextDestroy(ctx) != 0){
+        status = EXIT_FAILURE;
+    }
+
+    free(rows);
+    free(cols);
+    free(results);
+
+    return status;
+}
+
+
+
+void defaultEngineOpts(engine_opts *opts){
+
+    opts->engine = ENGINE_AUTO;
+    opts->num_threads = 0;
+    opts->tile_rows = 0;
+    opts->tile_cols = 0;
+    opts->stats = 0;
+    opts->barrier = BARRIER_MUTEX;
+    opts->affinity = 0;
+    opts->cache = 0;
+    opts->cache_file = NULL;
+    opts->groups = 1;
+    opts->grid_file = NULL;
+    opts->layout = GRID_ROW_MAJOR;
+    opts->explain = 0;
+}
+
+
+const char * engineName(engine_kind engine){
+
+    switch(engine){
+
+        case ENGINE_AUTO:     return "auto";
+        case ENGINE_CELL:     return "cell";
+        case ENGINE_PIPELINE: return "pipeline";
+        case ENGINE_TILED:    return "tiled";
+        case ENGINE_RECURSIVE: return "recursive";
+        case ENGINE_SIMD:     return "simd";
+        case ENGINE_STREAM:   return "stream";
+#ifdef STENCIL_DELANNOY
+        case ENGINE_CLOSED:   return "closed";
+#else
+        case ENGINE_CLOSED:   break;
+#endif
+#ifdef WF_GPU
+        case ENGINE_GPU:      return "gpu";
+#endif
+        case ENGINE_COUNT:    break;
+    }
+
+    return "unknown";
+}
+
+
+int engineFromName(const char *name, engine_kind *engine){
+
+    for(int e=0; e < ENGINE_COUNT; e++){
+
+        if(strcmp(name, engineName((engine_kind) e)) == 0){
+            *engine = (engine_kind) e;
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+
+/** Run one computation in a context of its own (see wavefrontContextCreate()).*/
+int wavefront(int num_state_rows, int num_state_cols, int numRounds, const engine_opts *opts){
+
+    wavefront_context *ctx = wavefrontContextCreate(num_state_rows, num_state_cols, opts);
+    if(ctx == NULL){
+        return EXIT_FAILURE;
+    }
+
+    int status = wavefrontRun(ctx, num_state_rows, num_state_cols, numRounds, NULL);
 
-	wavefront(nrows, ncols, reps);
+    if(wavefrontContextDestroy(ctx) != 0){
+        return EXIT_FAILURE;
+    }
+
+    return status;
 }
 
 
@@ -73,13 +496,17 @@ int main( int argc, char *argv[]){
  *  considered to be the result. The result is printed to stdout, but not returned.
  *
  *
+ *  @param sa the state array to reuse (see acquireStateArray()); set to the array used
  *  @param num_state_rows number of rows in the state array
  *  @param num_state_cols number of columns in the state array
  *  @param numRounds number of rounds to repeat
+ *  @param opts the engine options. If the engine is ENGINE_PIPELINE, the rounds are
+ *      pipelined (see doPipelinedWork()) rather than separated by a barrier.
  *  @return 0 on success, or an error code
  */
 
-int wavefront(int num_state_rows, int num_state_cols, int numRounds){
+int cellWavefront(state_array_t **sa, int num_state_rows, int num_state_cols, int numRounds,
+                  const engine_opts *opts){
 
     // The thread array will be smaller than the state_array, because
     // of the border elements. The border elements won't have a
@@ -91,69 +518,113 @@ int wavefront(int num_state_rows, int num_state_cols, int numRounds){
     int thread_arr_len = num_thread_rows * num_thread_cols;
     // printf("Thread Array len is %d\n", thread_arr_len);
 
-    createStateArray(num_state_rows, num_state_cols);
+    // The state array is kept for the next query in the same context, which frees it.
+    *sa = acquireStateArray(*sa, num_state_rows, num_state_cols, opts->affinity);
+    if(*sa == NULL){
+        return EXIT_FAILURE;
+    }
+    if(opts->affinity){
+        affinityReport(stderr, thread_arr_len, num_state_rows);
+    }
 
     pthread_t * thread_arr = malloc(thread_arr_len * sizeof(pthread_t));
 
+    // In pipelined mode there is no barrier between rounds. Element 0 records each
+    // result here instead, since it may have moved on to a later round by the time
+    // the main thread gets around to printing.
+    int pipelined = (opts->engine == ENGINE_PIPELINE);
+    value_t *results = pipelined ? malloc((numRounds > 0 ? numRounds : 1) * sizeof(value_t))
+                                 : NULL;
+
+    // The control blocks of all threads, in thread order. sizeof(thread_function_args) is
+    // a multiple of CACHE_LINE, which aligned_alloc() needs.
+    thread_function_args *arena = aligned_alloc(CACHE_LINE,
+        (thread_arr_len > 0 ? thread_arr_len : 1) * sizeof(thread_function_args));
+
     barrier_t barrier;
 
 
 
     // Why is the barrier initialized for thread_arr_len + 1 threads?
-    if(barrier_init(&barrier, thread_arr_len + 1, barrier_function) != 0){
+    if(thread_arr == NULL || (pipelined && results == NULL) || arena == NULL
+       || barrier_init_kind(&barrier, thread_arr_len + 1, barrier_function, opts->barrier) != 0){
+
+        free(thread_arr);
+        free(results);
+        free(arena);
         return EXIT_FAILURE;
     }
 
 
-    //TODO: Write me.
-    // As usual, we need a loop that creates the threads. No load balancing is
-    // involved, but there's another complication. The thread_arr and state_array
-    // are different sizes. Each thread needs to know its position in the
-    // state_array, but pthread_create() needs to index the thread_arr.
-    //
-    // The index() function in state_array.c will help map (row, column) coordinates
-    // to an index in the state_array, but don't use that index with thread_arr.
-    //
-    // There's many ways to solve this issue.
-    //
-    // With that said, the contents of the loop are otherwise straightforward:
-    //    malloc a new thread_function_args and set its fields,
-    //    then create your thread
-
-
+    // Arena slot (and thread_arr entry) t is the t-th interior element in row-major order,
+    // and its s_index is that element's index in the state array.
 
     // After the threads have been launched, the loop below prints out
     // the result after each round. The same value should be printed each
     // time.
+    grid_t g = getGrid(*sa);
     int thrd_count = 0;
     for(int i=0; i<num_state_rows; i++){
       for(int j=0; j<num_state_cols; j++){
         if((i!=num_thread_rows) && (j!=num_thread_cols)){
-          int idx = index(i,j);
+          int idx = gridIndex(g, i, j);
           // printf("Current Idx is %d\n", idx);
-          thread_function_args * args = malloc(sizeof(thread_function_args));
+          thread_function_args * args = &arena[thrd_count];
+          args->sa = *sa;
           args->s_index = idx;
+          args->e_idx = gridE(g, idx);
+          args->s_idx = gridS(g, idx);
+          args->es_idx = gridSE(g, idx);
           args->numRounds = numRounds;
           args->barrier = &barrier;
+          args->results = results;
+          memset(&args->stats, 0, sizeof(cell_stats));
+          args->cpu = opts->affinity ? affinityCpu(thrd_count, thread_arr_len) : -1;
+          args->t_index = thrd_count;
+          args->num_threads = thread_arr_len;
+          args->threads = thread_arr;
+          args->arena = arena;
+          args->fn = pipelined ? doPipelinedWork : doWork;
           // printf("Current Thread Idx is %d\n", thrd_count);
-          pthread_create(&(thread_arr[thrd_count]), NULL, doWork, args);
           thrd_count++;
         }
     }
   }
 
-    initBorders();
+    // Creating thousands of threads one after the other from here would make the last
+    // one wait for all the others, so only the root of the spawn tree is started here,
+    // and each thread starts its own children.
+    if(thread_arr_len > 0 && pthread_create(&thread_arr[0], NULL, arena[0].fn, &arena[0]) != 0){
+
+        barrier_destroy(&barrier);
+        free(thread_arr);
+        free(results);
+        free(arena);
+        return EXIT_FAILURE;
+    }
+
+    initBorders(*sa);
 
     for(int round=0; round < numRounds; round++){
 
-	    barrier_wait(&barrier, NULL);
+      if(pipelined){
+
+        // Element 0 has no dependents, so it never waits for the main thread.
+        waitOnNeighbor(*sa, 0, round + 1);
+        gResult = (thread_arr_len > 0) ? results[round] : getSumPlane(*sa)[0];
+      } else {
+
+	      barrier_wait_id(&barrier, thread_arr_len, *sa);
+      }
       // printf("%s\n", "Came into loop");
-		  printf("Round %d, result is %d\n", round, gResult);
+      reportRound(round, gResult);
 
     }
 
 
 
+    // A thread's parent has a lower index, so by the time thread i is joined, its parent
+    // has been joined, and thread_arr[i] has been filled in.
     for (int i=0; i<thread_arr_len; i++){
 
         if (pthread_join(thread_arr[i], NULL) != 0){
@@ -162,7 +633,21 @@ int wavefront(int num_state_rows, int num_state_cols, int numRounds){
         }
     }
 
-    destroyStateArray();
+#ifdef WF_INSTRUMENT
+    // The report wants the counters indexed like the state array, without its padding.
+    cell_stats *stats = calloc((size_t) num_state_rows * num_state_cols, sizeof(cell_stats));
+    int stride = getRowStride(*sa);
+    for(int i=0; i < thread_arr_len; i++){
+        int s = arena[i].s_index;
+        stats[(s / stride) * num_state_cols + s % stride] = arena[i].stats;
+    }
+    instrumentReport(stats, num_state_rows, num_state_cols, stderr);
+    free(stats);
+#endif
+
+    free(thread_arr);
+    free(results);
+    free(arena);
 
     if (barrier_destroy(&barrier) != 0){
 
@@ -174,90 +659,156 @@ int wavefront(int num_state_rows, int num_state_cols, int numRounds){
 
 
 
+/** Start the children of a thread in the spawn tree, threads 2t + 1 and 2t + 2, so that a
+ *  computation with n threads is fully started after about log2(n) generations.
+ *
+ *  A child that can't be created takes its whole subtree with it, and the others would wait
+ *  for their missing neighbors forever, so the process exits instead.
+ */
+static void spawnChildren(const thread_function_args *args){
+
+    for(int c = 2 * args->t_index + 1; c <= 2 * args->t_index + 2 && c < args->num_threads; c++){
+
+        thread_function_args *child = &args->arena[c];
+        int err = pthread_create(&args->threads[c], NULL, child->fn, child);
+        if(err != 0){
+            fprintf(stderr, "cell engine: can't start thread %d of %d: %s\n", c,
+                    args->num_threads, strerror(err));
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+
+
 /** The thread function. After unpacking the arguments, this function performs a specified
- *  number of rounds of a small piece of a wavefront computation. Using the condition variables
- *  in the state array, the thread first waits for a signal from each of its east, south, and
- *  southeast neighbors. When this thread has received a signal from these three neighbors, it
- *  can compute the sum value for its own element in the state array. Next, it signals all
- *  threads waiting on its own element, and then synchronizes with the other threads at a
+ *  number of rounds of a small piece of a wavefront computation. Using waitOnNeighbor(), the
+ *  thread first waits for each of its east, south, and southeast neighbors to be ready for
+ *  the current round. When these three neighbors are ready, it can compute the sum value for
+ *  its own element in the state array. Next, it publishes the sum, waking all threads
+ *  waiting on its own element, and then synchronizes with the other threads at a
  *  barrier. After the barrier, the process is repeated until the specified number of rounds
  *  have been executed.
 */
 void *doWork(void *a){
     // printf("%s\n", "Do work a aschi");
     thread_function_args * args = (thread_function_args * ) a;
+    state_array_t *sa = args->sa;
     int idx = args->s_index;
     int nRounds = args->numRounds;
     barrier_t *barr = args->barrier;
+#ifdef WF_INSTRUMENT
+    cell_stats *st = &args->stats;
+#endif
 
-    free(args);
-    args = NULL; a=NULL;
-
+    if(args->cpu >= 0){
+        affinityPin(args->cpu);
+    }
+    spawnChildren(args);
 
+    // The block stays in the arena until the thread is joined.
+    int e_idx = args->e_idx;
+    int s_idx = args->s_idx;
+    int es_idx = args->es_idx;
 
-    int e_idx = E(idx);
-    int s_idx = S(idx);
-    int es_idx = s_idx + 1;
+    // The position of the element for the stencil, counted from the south-east corner.
+    grid_t g = getGrid(sa);
+    int r = gridRows(g) - 1 - idx / gridStride(g);
+    int c = gridCols(g) - 1 - idx % gridStride(g);
     // printf("Main Index: %d, East Index: %d, South Index: %d, South-East Index: %d\n", idx, e_idx, s_idx, es_idx);
 
-    //TODO: Write me.
-    // Take a look at the functions available through state_array.c.
-    //
-    // Consider implementing waitOnNeighbor() in state_array.c for cleaner
-    // looking code, but it's fine if you'd prefer all your mutex/CV code in one
-    // place, at least to begin with.
-    //
-    // Also, use pthread_cond_broadcast() rather than pthread_cond_signal(). You
-    // want to wake _all_ sleeping threads, not just one.
-
     for(int round = 0; round<nRounds; round++){
 
-      int s_sum, e_sum, es_sum = 0;
+      // An element is ready for this round once its epoch reaches round + 1. Border
+      // elements are always ready.
+      int epoch = round + 1;
 
-      pthread_mutex_lock(&getStateArray()[e_idx].lock);
-      if (getStateArray()[e_idx].sum == 0){
-        pthread_cond_wait(&getStateArray()[e_idx].cv, &getStateArray()[e_idx].lock);
-      }
+      INSTR_START(t);
+      INSTR_COUNT_WAIT(st, sa, e_idx, epoch);
+      INSTR_COUNT_WAIT(st, sa, s_idx, epoch);
+      INSTR_COUNT_WAIT(st, sa, es_idx, epoch);
 
-      e_sum = getStateArray()[e_idx].sum;
+      value_t e_sum = waitOnNeighbor(sa, e_idx, epoch);
+      value_t s_sum = waitOnNeighbor(sa, s_idx, epoch);
+      value_t es_sum = waitOnNeighbor(sa, es_idx, epoch);
+      INSTR_CHARGE(st, neighbor_wait_ns, t);
 
-      pthread_mutex_unlock(&getStateArray()[e_idx].lock);
+      publishState(sa, idx, stencilCombine(e_sum, s_sum, es_sum, r, c), epoch);
+      INSTR_CHARGE(st, compute_ns, t);
 
-      pthread_mutex_lock(&getStateArray()[s_idx].lock);
-      if (getStateArray()[s_idx].sum == 0){
-        pthread_cond_wait(&getStateArray()[s_idx].cv, &getStateArray()[s_idx].lock);
-      }
+     barrier_wait_id(barr, args->t_index, sa);
+      INSTR_CHARGE(st, barrier_wait_ns, t);
+   }
 
-      s_sum = getStateArray()[s_idx].sum;
 
-      pthread_mutex_unlock(&getStateArray()[s_idx].lock);
+    return NULL;
+}
 
-      pthread_mutex_lock(&getStateArray()[es_idx].lock);
-      if (getStateArray()[es_idx].sum == 0){
-        pthread_cond_wait(&getStateArray()[es_idx].cv, &getStateArray()[es_idx].lock);
-      }
 
-      es_sum = getStateArray()[es_idx].sum;
+/** The thread function for pipelined mode. Each round is the same as in doWork(), but
+ *  there is no barrier and no reset between rounds: the epoch of each element says which
+ *  round its sum belongs to, so the wave of round r+1 can start in the south-east corner
+ *  while round r is still finishing in the north-west.
+ *
+ *  Each element holds only one sum, so before overwriting the sum of round r-1, the thread
+ *  waits for the elements that read it (the north, west, and north-west neighbors) to have
+ *  finished round r-1. That keeps every element within one round of its dependents.
+*/
+void *doPipelinedWork(void *a){
 
-      pthread_mutex_unlock(&getStateArray()[es_idx].lock);
+    thread_function_args * args = (thread_function_args * ) a;
+    state_array_t *sa = args->sa;
+    int idx = args->s_index;
+    int nRounds = args->numRounds;
+    value_t *results = args->results;
+#ifdef WF_INSTRUMENT
+    cell_stats *st = &args->stats;
+#endif
 
+    if(args->cpu >= 0){
+        affinityPin(args->cpu);
+    }
+    spawnChildren(args);
 
-      pthread_mutex_lock(&getStateArray()[idx].lock);
-      // printf("S sum: %d E sum: %d ES sum: %d\n", s_sum, e_sum, es_sum );
+    grid_t g = getGrid(sa);
+    int has_north = (idx >= gridStride(g));
+    int has_west = (idx % gridStride(g) != 0);
+    int r = gridRows(g) - 1 - idx / gridStride(g);
+    int c = gridCols(g) - 1 - idx % gridStride(g);
 
-      if ((e_sum != 0) && (s_sum != 0) && (es_sum != 0)){
-        getStateArray()[idx].sum = e_sum +
-                s_sum +
-                es_sum ;
-        pthread_cond_broadcast(&getStateArray()[idx].cv);
+    int e_idx = args->e_idx;
+    int s_idx = args->s_idx;
+    int es_idx = args->es_idx;
+
+    for(int round = 0; round<nRounds; round++){
+
+      int epoch = round + 1;
+      INSTR_START(t);
+
+      // Wait for the previous sum to be consumed. Only the epochs matter here.
+      if(round > 0){
+        if(has_north) waitOnNeighbor(sa, gridN(g, idx), round);
+        if(has_west) waitOnNeighbor(sa, gridW(g, idx), round);
+        if(has_north && has_west) waitOnNeighbor(sa, gridNW(g, idx), round);
       }
 
-      pthread_mutex_unlock(&getStateArray()[idx].lock);
+      INSTR_COUNT_WAIT(st, sa, e_idx, epoch);
+      INSTR_COUNT_WAIT(st, sa, s_idx, epoch);
+      INSTR_COUNT_WAIT(st, sa, es_idx, epoch);
 
+      value_t e_sum = waitOnNeighbor(sa, e_idx, epoch);
+      value_t s_sum = waitOnNeighbor(sa, s_idx, epoch);
+      value_t es_sum = waitOnNeighbor(sa, es_idx, epoch);
+      INSTR_CHARGE(st, neighbor_wait_ns, t);
 
-     barrier_wait(barr, NULL);
-   }
+      value_t sum = stencilCombine(e_sum, s_sum, es_sum, r, c);
+      if(idx == 0){
+        results[round] = sum;
+      }
 
+      publishState(sa, idx, sum, epoch);
+      INSTR_CHARGE(st, compute_ns, t);
+    }
 
     return NULL;
 }
@@ -265,18 +816,18 @@ void *doWork(void *a){
 
 /** This function is executed by the last thread to enter the barrier. It is executed under
  *  the protection of the barrier mutex, which guarantees that it runs before the other
- *  threads have started running.
+ *  threads have started running. Every thread passes the state array to barrier_wait_id(),
+ *  so a is the array of the computation.
  *
- *  The function does three things: It sets gResult to the sum value of element 0 of the
- *  state array. It resets all sum values in the whole state array to 0. It sets the sums
- *  of the border elements to 1.
+ *  The function sets gResult to the sum value of element 0 of the state array. The state
+ *  array isn't reset between rounds: the epoch of each element says which round its sum
+ *  belongs to, so the sums of the last round can't be mistaken for those of the next one,
+ *  and the border elements keep an epoch that is ready for every round. That keeps the
+ *  work done here, while every other thread is waiting, independent of the grid size.
  */
 void * barrier_function(void * a){
   // printf("%s\n", "Barrier call hocche");
-	gResult = getStateArray()[0].sum;
-
- 	  resetStateArray();
-    initBorders();
+	gResult = getSumPlane((state_array_t *) a)[0];
 
     return NULL;
 }
@@ -0,0 +1,213 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mpi.h>
+
+#include "value.h"
+#include "stencil.h"
+#include "report.h"
+#include "wavefront.h"
+
+/** A distributed wavefront engine. The state array is split into bands of rows, one band
+ *  per MPI rank, so each rank only holds (its rows + 1) x ncols elements: rank 0 has the
+ *  north band, which holds element 0, and the last rank has the south band, which sits on
+ *  the border row.
+ *
+ *  The wave starts at the south-east corner, so each band needs the row just south of it,
+ *  which is the north row of the next rank's band. Instead of waiting for the whole band
+ *  below, a rank works through its band in blocks of columns, from east to west. As soon
+ *  as it finishes a block, it sends the block's north row to the rank above, which can
+ *  then compute its own block of those columns. That keeps all ranks busy on different
+ *  blocks at once, like the tiles of the tiled engine.
+ *
+ *  Element 0 is on rank 0, so reporting a round needs no communication: rank 0 prints the
+ *  result with reportRound() once its band is done. Messages between two ranks arrive in
+ *  order, so rounds need no barrier either; a rank only waits for its sends to complete
+ *  before it overwrites its band in the next round.
+ *
+ *  Usage: mpirun -n P ./a3_mpi [-b block_cols] nrows ncols reps [nrows ncols reps ...]
+ *      -b sets the number of columns per block (default DEFAULT_TILE_SIZE). Smaller
+ *          blocks start the ranks sooner, at the cost of more messages.
+ */
+
+
+
+// One rank's share of a computation.
+typedef struct{
+
+    int rank, num_ranks;
+    int ncols;
+    int band_rows;          // rows of the band; the row after them is the halo
+    int halo_r;             // the row of the halo, counted from the south-east corner
+    int block_cols;
+    value_t *band;          // (band_rows + 1) x ncols, row-major
+    MPI_Request *sends;     // one per block
+} rank_band;
+
+
+
+/** Return the number of interior rows of an nrows-row array held by a rank, and set
+ *  *first to the first of them. Row nrows - 1 is the border, so it isn't in any band.
+ */
+static int bandRows(int nrows, int rank, int num_ranks, int *first){
+
+    int interior = nrows - 1;
+    int base = interior / num_ranks;
+    int extra = interior % num_ranks;
+
+    *first = rank * base + (rank < extra ? rank : extra);
+
+    return base + (rank < extra ? 1 : 0);
+}
+
+
+/** Compute one round of a rank's band, and return element 0 of it (meaningful on rank 0).*/
+static value_t runBand(rank_band *b){
+
+    int C = b->ncols;
+    int H = b->band_rows;
+    value_t *halo = b->band + (size_t) H * C;
+
+    // The last rank's halo is the border row; the others receive theirs block by block.
+    // The east border column is in every row.
+    int last = (b->rank == b->num_ranks - 1);
+    for(int r=0; r <= H; r++){
+        b->band[(size_t) r * C + C - 1] = stencilBorder(b->halo_r + H - r, 0);
+    }
+    if(last){
+        for(int c=0; c < C; c++){
+            halo[c] = stencilBorder(0, C - 1 - c);
+        }
+    }
+
+    int num_blocks = 0;
+    for(int c1 = C - 1; c1 > 0; c1 -= b->block_cols){
+
+        int c0 = c1 - b->block_cols > 0 ? c1 - b->block_cols : 0;
+
+        if(!last){
+            MPI_Recv(halo + c0, (c1 - c0) * (int) sizeof(value_t), MPI_BYTE, b->rank + 1,
+                     0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        }
+
+        for(int r = H - 1; r >= 0; r--){
+
+            value_t *row = b->band + (size_t) r * C;
+            value_t *south = row + C;
+            int se_r = b->halo_r + H - r;
+
+            for(int c = c1 - 1; c >= c0; c--){
+                row[c] = stencilCombine(row[c + 1], south[c], south[c + 1], se_r, C - 1 - c);
+            }
+        }
+
+        // An empty band just passes its halo on.
+        if(b->rank > 0){
+            MPI_Isend(b->band + c0, (c1 - c0) * (int) sizeof(value_t), MPI_BYTE, b->rank - 1,
+                      0, MPI_COMM_WORLD, &b->sends[num_blocks]);
+        }
+        num_blocks++;
+    }
+
+    if(b->rank > 0){
+        MPI_Waitall(num_blocks, b->sends, MPI_STATUSES_IGNORE);
+    }
+
+    return b->band[0];
+}
+
+
+/** Run the rounds of one computation on every rank.
+ *  @return 0 on success, or an error code
+ */
+static int mpiWavefront(int num_state_rows, int num_state_cols, int numRounds, int block_cols){
+
+    rank_band b;
+    MPI_Comm_rank(MPI_COMM_WORLD, &b.rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &b.num_ranks);
+
+    // With no interior, element 0 is a border element.
+    if(num_state_rows < 2 || num_state_cols < 2){
+
+        for(int round=0; round < numRounds && b.rank == 0; round++){
+            reportRound(round, stencilBorder(num_state_rows - 1, num_state_cols - 1));
+        }
+        return EXIT_SUCCESS;
+    }
+
+    int first;
+    b.ncols = num_state_cols;
+    b.band_rows = bandRows(num_state_rows, b.rank, b.num_ranks, &first);
+    b.halo_r = num_state_rows - 1 - (first + b.band_rows);
+    b.block_cols = block_cols;
+    b.band = malloc((size_t)(b.band_rows + 1) * num_state_cols * sizeof(value_t));
+    b.sends = malloc(((num_state_cols - 1) / block_cols + 1) * sizeof(MPI_Request));
+
+    int ok = (b.band != NULL && b.sends != NULL), all_ok;
+    MPI_Allreduce(&ok, &all_ok, 1, MPI_INT, MPI_LAND, MPI_COMM_WORLD);
+
+    if(all_ok){
+
+        for(int round=0; round < numRounds; round++){
+
+            value_t result = runBand(&b);
+            if(b.rank == 0){
+                reportRound(round, result);
+            }
+        }
+    }
+
+    free(b.band);
+    free(b.sends);
+
+    return all_ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+
+
+int main(int argc, char *argv[]){
+
+    MPI_Init(&argc, &argv);
+
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    int block_cols = DEFAULT_TILE_SIZE;
+    int q = 1;
+    if(argc > 2 && strcmp(argv[1], "-b") == 0){
+        block_cols = atoi(argv[2]);
+        q = 3;
+    }
+
+    if(block_cols < 1 || argc - q < 3 || (argc - q) % 3 != 0){
+
+        if(rank == 0){
+            printf("Usage: mpirun -n P ./a3_mpi [-b block_cols] nrows ncols reps [nrows ncols reps ...]\n");
+        }
+        MPI_Finalize();
+        return EXIT_FAILURE;
+    }
+
+    int status = EXIT_SUCCESS;
+    for(; q < argc && status == EXIT_SUCCESS; q += 3){
+
+        int nrows = atoi(argv[q]);
+        int ncols = atoi(argv[q + 1]);
+        int reps  = atoi(argv[q + 2]);
+
+        if(nrows < 1 || ncols < 1){
+            if(rank == 0){
+                fprintf(stderr, "Bad grid size: %d x %d\n", nrows, ncols);
+            }
+            status = EXIT_FAILURE;
+            break;
+        }
+
+        status = mpiWavefront(nrows, ncols, reps, block_cols);
+    }
+
+    fflush(stdout);
+    MPI_Finalize();
+
+    return status;
+}
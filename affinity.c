@@ -0,0 +1,346 @@
+// sched_getaffinity() and pthread_setaffinity_np() are GNU extensions, so this file doesn't
+// include state_array.h (see the note on index() there).
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "affinity.h"
+
+// Nodes beyond this many are folded into the last one.
+#define AFFINITY_MAX_NODES 64
+
+
+// The topology, read once by affinityInit(). Nodes are numbered 0..num_nodes-1 in the
+// order of their system ids, and only nodes with an allowed CPU are counted.
+static pthread_once_t topo_once = PTHREAD_ONCE_INIT;
+static int topo_status = -1;
+
+static int num_cpus = 0;
+static int cpu_order[CPU_SETSIZE];              // allowed CPUs, grouped by node
+static int cpu_node[CPU_SETSIZE];               // node of each CPU
+
+static int num_nodes = 0;
+static int node_id[AFFINITY_MAX_NODES];         // system id of each node
+static int node_first[AFFINITY_MAX_NODES];      // position of its first CPU in cpu_order
+static int node_len[AFFINITY_MAX_NODES];        // number of its CPUs
+
+
+
+/** Parse a sysfs CPU list such as "0-3,8-11" and mark each CPU in it.*/
+static void parseCpuList(const char *list, cpu_set_t *set){
+
+    CPU_ZERO(set);
+
+    const char *p = list;
+    while(*p != '\0' && *p != '\n'){
+
+        char *end;
+        long lo = strtol(p, &end, 10);
+        if(end == p){
+            return;
+        }
+        long hi = lo;
+        p = end;
+
+        if(*p == '-'){
+            hi = strtol(p + 1, &end, 10);
+            p = end;
+        }
+
+        for(long c=lo; c <= hi && c < CPU_SETSIZE; c++){
+            CPU_SET((int) c, set);
+        }
+
+        if(*p == ','){
+            p++;
+        }
+    }
+}
+
+
+/** Read the node of every CPU from /sys/devices/system/node, in increasing node id order.
+ *  @return the number of nodes found, or 0 if the directory can't be read
+ */
+static int readNodes(int *ids, cpu_set_t *cpus){
+
+    DIR *dir = opendir("/sys/devices/system/node");
+    if(dir == NULL){
+        return 0;
+    }
+
+    int n = 0;
+    struct dirent *ent;
+    while((ent = readdir(dir)) != NULL && n < AFFINITY_MAX_NODES){
+
+        int id;
+        char tail;
+        if(sscanf(ent->d_name, "node%d%c", &id, &tail) != 1){
+            continue;
+        }
+
+        char path[288];
+        snprintf(path, sizeof(path), "/sys/devices/system/node/%s/cpulist", ent->d_name);
+
+        FILE *f = fopen(path, "r");
+        if(f == NULL){
+            continue;
+        }
+
+        char list[4096];
+        if(fgets(list, sizeof(list), f) != NULL){
+
+            // Insertion sort by id, since readdir() returns entries in no particular order.
+            int k = n;
+            while(k > 0 && ids[k - 1] > id){
+                ids[k] = ids[k - 1];
+                cpus[k] = cpus[k - 1];
+                k--;
+            }
+            ids[k] = id;
+            parseCpuList(list, &cpus[k]);
+            n++;
+        }
+        fclose(f);
+    }
+
+    closedir(dir);
+
+    return n;
+}
+
+
+static void readTopology(){
+
+    cpu_set_t allowed;
+    if(sched_getaffinity(0, sizeof(allowed), &allowed) != 0){
+        return;
+    }
+
+    static int ids[AFFINITY_MAX_NODES];
+    static cpu_set_t cpus[AFFINITY_MAX_NODES];
+    int n = readNodes(ids, cpus);
+
+    if(n == 0){
+        // No topology: one node with every allowed CPU.
+        n = 1;
+        ids[0] = 0;
+        cpus[0] = allowed;
+    }
+
+    num_cpus = 0;
+    num_nodes = 0;
+
+    for(int k=0; k < n; k++){
+
+        int first = num_cpus;
+        for(int c=0; c < CPU_SETSIZE; c++){
+
+            if(CPU_ISSET(c, &cpus[k]) && CPU_ISSET(c, &allowed)){
+                CPU_CLR(c, &allowed);
+                cpu_node[c] = num_nodes;
+                cpu_order[num_cpus++] = c;
+            }
+        }
+
+        if(num_cpus > first){
+            node_id[num_nodes] = ids[k];
+            node_first[num_nodes] = first;
+            node_len[num_nodes] = num_cpus - first;
+            num_nodes++;
+        }
+    }
+
+    // Allowed CPUs that no node lists go with the last node.
+    if(num_nodes == 0){
+        node_id[0] = 0;
+        node_first[0] = 0;
+        node_len[0] = 0;
+        num_nodes = 1;
+    }
+    for(int c=0; c < CPU_SETSIZE; c++){
+
+        if(CPU_ISSET(c, &allowed)){
+            cpu_node[c] = num_nodes - 1;
+            cpu_order[num_cpus++] = c;
+            node_len[num_nodes - 1]++;
+        }
+    }
+
+    topo_status = (num_cpus > 0) ? 0 : -1;
+}
+
+
+int affinityInit(){
+
+    pthread_once(&topo_once, readTopology);
+
+    return topo_status;
+}
+
+
+int affinityNumCpus(){
+
+    affinityInit();
+    return num_cpus > 0 ? num_cpus : 1;
+}
+
+
+int affinityNumNodes(){
+
+    affinityInit();
+    return num_nodes > 0 ? num_nodes : 1;
+}
+
+
+int affinityCpu(int worker, int num_workers){
+
+    if(affinityInit() != 0 || num_workers < 1){
+        return 0;
+    }
+
+    return cpu_order[(long) worker * num_cpus / num_workers];
+}
+
+
+int affinityNode(int cpu){
+
+    if(affinityInit() != 0 || cpu < 0 || cpu >= CPU_SETSIZE){
+        return 0;
+    }
+
+    return cpu_node[cpu];
+}
+
+
+void affinityBand(int node, int n, int *begin, int *end){
+
+    if(affinityInit() != 0){
+        *begin = (node == 0) ? 0 : n;
+        *end = n;
+        return;
+    }
+
+    // Worker w is on this node when w * num_cpus / n falls in the node's CPU positions.
+    int lo = node_first[node];
+    int hi = node_first[node] + node_len[node];
+
+    *begin = (int)(((long) lo * n + num_cpus - 1) / num_cpus);
+    *end = (int)(((long) hi * n + num_cpus - 1) / num_cpus);
+}
+
+
+int affinityPin(int cpu){
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+
+
+// The arguments of a thread started by affinityOnNodes().
+typedef struct{
+
+    int node;
+    affinity_node_fn fn;
+    void *ctx;
+} node_args;
+
+
+static void * nodeThread(void *a){
+
+    node_args *args = (node_args *) a;
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for(int i=0; i < node_len[args->node]; i++){
+        CPU_SET(cpu_order[node_first[args->node] + i], &set);
+    }
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+
+    args->fn(args->node, args->ctx);
+
+    return NULL;
+}
+
+
+int affinityOnNodes(affinity_node_fn fn, void *ctx){
+
+    if(affinityInit() != 0){
+        fn(0, ctx);
+        return 0;
+    }
+
+    pthread_t threads[AFFINITY_MAX_NODES];
+    node_args args[AFFINITY_MAX_NODES];
+
+    int started = 0;
+    for(; started < num_nodes; started++){
+
+        args[started].node = started;
+        args[started].fn = fn;
+        args[started].ctx = ctx;
+
+        if(pthread_create(&threads[started], NULL, nodeThread, &args[started]) != 0){
+            break;
+        }
+    }
+
+    // The nodes without a thread are run from here, unpinned, while the others run.
+    for(int k=started; k < num_nodes; k++){
+        fn(k, ctx);
+    }
+
+    int status = 0;
+    for(int k=0; k < started; k++){
+
+        if(pthread_join(threads[k], NULL) != 0){
+            status = EXIT_FAILURE;
+        }
+    }
+
+    return status;
+}
+
+
+void affinityReport(FILE *out, int num_workers, int num_rows){
+
+    if(affinityInit() != 0){
+        fprintf(out, "affinity: topology unavailable, threads not pinned\n");
+        return;
+    }
+
+    fprintf(out, "affinity: %d node%s, %d cpu%s, %d worker%s\n",
+            num_nodes, num_nodes == 1 ? "" : "s", num_cpus, num_cpus == 1 ? "" : "s",
+            num_workers, num_workers == 1 ? "" : "s");
+
+    for(int k=0; k < num_nodes; k++){
+
+        fprintf(out, "  node %d: cpus", node_id[k]);
+        for(int i=0; i < node_len[k]; i++){
+            fprintf(out, "%s%d", i == 0 ? " " : ",", cpu_order[node_first[k] + i]);
+        }
+
+        int w0, w1, r0, r1;
+        affinityBand(k, num_workers, &w0, &w1);
+        affinityBand(k, num_rows, &r0, &r1);
+
+        if(w1 > w0){
+            fprintf(out, "; workers %d-%d", w0, w1 - 1);
+        } else {
+            fprintf(out, "; no workers");
+        }
+        if(r1 > r0){
+            fprintf(out, "; rows %d-%d\n", r0, r1 - 1);
+        } else {
+            fprintf(out, "; no rows\n");
+        }
+    }
+}
@@ -0,0 +1,69 @@
+#ifndef AFFINITY_H
+#define AFFINITY_H
+
+/*
+ * affinity.h
+ *
+ * Thread placement for the wavefront engines. The CPUs the process may run on are put in
+ * a locality-preserving order: grouped by NUMA node, and by CPU number within a node.
+ * Worker w of n is given the CPU at position w * num_cpus / n in that order, so workers
+ * with nearby numbers (and therefore nearby rows of the state array) share a node, and
+ * the rows of the state array can be split into one band per node in the same proportion.
+ *
+ * The topology is read from /sys/devices/system/node on Linux. Elsewhere, or if that
+ * fails, every CPU is treated as part of node 0 and pinning is a no-op.
+ */
+#include <stdio.h>
+
+
+// A function run on a thread pinned to one node by affinityOnNodes().
+typedef void (* affinity_node_fn)(int node, void *ctx);
+
+
+/** Read the topology, if it hasn't been read already. Safe to call more than once.
+ *  @return 0 on success, or -1 if the allowed CPUs couldn't be determined
+ */
+int affinityInit();
+
+/** Return the number of CPUs the process may run on.*/
+int affinityNumCpus();
+
+/** Return the number of NUMA nodes that have at least one of those CPUs.*/
+int affinityNumNodes();
+
+/** Return the CPU for worker number worker out of num_workers.*/
+int affinityCpu(int worker, int num_workers);
+
+/** Return the node of a CPU, or 0 if it isn't known.*/
+int affinityNode(int cpu);
+
+/** Return the share of items [*begin, *end) out of n that belongs to a node, in proportion
+ *  to its number of CPUs. The item a worker works on is in the band of its own node when
+ *  workers are numbered in item order.
+ */
+void affinityBand(int node, int n, int *begin, int *end);
+
+/** Pin the calling thread to a CPU.
+ *  @return 0 on success, or an error code
+ */
+int affinityPin(int cpu);
+
+/** Run fn once for each node, concurrently, each on a thread pinned to the CPUs of that
+ *  node, and wait for them all. Memory first touched by fn is then placed on its node. If
+ *  the thread of a node can't be started, fn is run for that node on the calling thread
+ *  instead, so it still runs exactly once per node.
+ *  @return 0 on success, or an error code if a thread couldn't be joined
+ */
+int affinityOnNodes(affinity_node_fn fn, void *ctx);
+
+/** Print the node of each CPU, the workers placed on each node, and the band of rows
+ *  that each node first-touches.
+ *
+ *  @param out the stream to print to
+ *  @param num_workers the number of pinned workers
+ *  @param num_rows the number of rows split into bands
+ */
+void affinityReport(FILE *out, int num_workers, int num_rows);
+
+
+#endif
@@ -0,0 +1,178 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/mman.h>
+
+#include "alloc.h"
+
+/** Huge-page blocks are anonymous mappings, which the kernel zeroes and only backs when
+ *  they are touched. An explicit huge-page mapping is rounded up to a whole number of huge
+ *  pages. A transparent one is over-mapped by a huge page and trimmed to start on a huge
+ *  page boundary, because the kernel can only use huge pages for aligned 2 MB ranges.
+ *
+ *  Note: this file uses _GNU_SOURCE for MAP_ANONYMOUS, MAP_HUGETLB and MADV_HUGEPAGE, so
+ *  it must not include state_array.h (see the note there).
+ */
+
+
+
+// This variable has "static" scope. The policy is set once, before any array is created.
+static alloc_pages policy = ALLOC_PAGES_AUTO;
+
+
+
+void allocSetPages(alloc_pages pages){
+
+    policy = pages;
+}
+
+
+const char * allocPagesName(alloc_pages pages){
+
+    switch(pages){
+
+        case ALLOC_PAGES_AUTO:      return "auto";
+        case ALLOC_PAGES_SMALL:     return "small";
+        case ALLOC_PAGES_THP:       return "thp";
+        case ALLOC_PAGES_HUGETLB:   return "hugetlb";
+    }
+
+    return "unknown";
+}
+
+
+int allocPagesFromName(const char *name, alloc_pages *pages){
+
+    for(int p=ALLOC_PAGES_AUTO; p <= ALLOC_PAGES_HUGETLB; p++){
+
+        if(strcmp(name, allocPagesName((alloc_pages) p)) == 0){
+            *pages = (alloc_pages) p;
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+
+/** Map a block on explicit huge pages.
+ *  @return 0 on success, or -1 if there are no free huge pages
+ */
+static int mapHugetlb(alloc_block *blk){
+
+#ifdef MAP_HUGETLB
+    size_t size = (blk->bytes + ALLOC_HUGE_SIZE - 1) / ALLOC_HUGE_SIZE * ALLOC_HUGE_SIZE;
+
+    void *p = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if(p == MAP_FAILED){
+        return -1;
+    }
+
+    blk->base = blk->ptr = p;
+    blk->size = size;
+    blk->pages = ALLOC_PAGES_HUGETLB;
+
+    return 0;
+#else
+    (void) blk;
+    return -1;
+#endif
+}
+
+
+/** Map a block aligned to a huge page, and ask for transparent huge pages on it.
+ *  @return 0 on success, or -1 if the mapping failed
+ */
+static int mapThp(alloc_block *blk){
+
+    size_t size = (blk->bytes + ALLOC_HUGE_SIZE - 1) / ALLOC_HUGE_SIZE * ALLOC_HUGE_SIZE;
+
+    char *p = mmap(NULL, size + ALLOC_HUGE_SIZE, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(p == MAP_FAILED){
+        return -1;
+    }
+
+    // Trim the mapping to [start, start + size).
+    char *start = (char *)(((uintptr_t) p + ALLOC_HUGE_SIZE - 1) / ALLOC_HUGE_SIZE * ALLOC_HUGE_SIZE);
+    if(start > p){
+        munmap(p, start - p);
+    }
+    if(start + size < p + size + ALLOC_HUGE_SIZE){
+        munmap(start + size, (p + size + ALLOC_HUGE_SIZE) - (start + size));
+    }
+
+    blk->base = blk->ptr = start;
+    blk->size = size;
+    blk->pages = ALLOC_PAGES_SMALL;
+
+#ifdef MADV_HUGEPAGE
+    // The mapping is still usable on small pages if THP is disabled.
+    if(madvise(start, size, MADV_HUGEPAGE) == 0){
+        blk->pages = ALLOC_PAGES_THP;
+    }
+#endif
+
+    return 0;
+}
+
+
+void * allocBlock(alloc_block *blk, size_t bytes){
+
+    blk->bytes = bytes;
+    blk->ptr = NULL;
+
+    if(bytes >= ALLOC_HUGE_SIZE && policy != ALLOC_PAGES_SMALL){
+
+        if((policy == ALLOC_PAGES_AUTO || policy == ALLOC_PAGES_HUGETLB) && mapHugetlb(blk) == 0){
+            return blk->ptr;
+        }
+        if(mapThp(blk) == 0){
+            return blk->ptr;
+        }
+    }
+
+    blk->base = calloc(bytes + ALLOC_ALIGN, 1);
+    if(blk->base == NULL){
+        return NULL;
+    }
+
+    blk->size = 0;
+    blk->ptr = (void *)(((uintptr_t) blk->base + ALLOC_ALIGN - 1) / ALLOC_ALIGN * ALLOC_ALIGN);
+    blk->pages = ALLOC_PAGES_SMALL;
+
+    return blk->ptr;
+}
+
+
+void allocFree(alloc_block *blk){
+
+    if(blk->ptr == NULL){
+        return;
+    }
+
+    if(blk->size > 0){
+        munmap(blk->base, blk->size);
+    } else {
+        free(blk->base);
+    }
+
+    blk->ptr = NULL;
+}
+
+
+int allocRowStride(int ncols, size_t entry_size){
+
+    int per_line = (int)(ALLOC_ALIGN / entry_size) > 0 ? (int)(ALLOC_ALIGN / entry_size) : 1;
+
+    int stride = (ncols + per_line - 1) / per_line * per_line;
+    if(((size_t) stride * entry_size) % 4096 == 0){
+        stride += per_line;
+    }
+
+    return stride;
+}
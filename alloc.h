@@ -0,0 +1,80 @@
+#ifndef ALLOC_H
+#define ALLOC_H
+
+#include <stddef.h>
+
+/*
+ * alloc.h
+ *
+ * Allocation of the state array's planes. Every block is zeroed, aligned to a cache line,
+ * and (except for small-page blocks from calloc()) only backed by memory when it is first
+ * written. Large blocks can be put on 2 MB pages, so a wave that crosses many rows of a
+ * multi-hundred-MB array doesn't miss in the TLB on every row:
+ *
+ *      ALLOC_PAGES_AUTO      try the blocks of at least ALLOC_HUGE_SIZE on explicit huge
+ *                            pages, then on transparent ones (the default)
+ *      ALLOC_PAGES_SMALL     plain calloc(), on 4 KB pages
+ *      ALLOC_PAGES_THP       transparent huge pages (madvise(MADV_HUGEPAGE))
+ *      ALLOC_PAGES_HUGETLB   explicit huge pages (MAP_HUGETLB), from the pool reserved in
+ *                            /proc/sys/vm/nr_hugepages
+ *
+ * Each step falls back to the next one if it fails, and every block records how it was
+ * actually allocated, for the stats output.
+ */
+
+// Blocks are aligned to this many bytes (CACHE_LINE in state_array.h).
+#define ALLOC_ALIGN 64
+
+// The size of a huge page, and the smallest block that is put on huge pages.
+#define ALLOC_HUGE_SIZE ((size_t) 2 << 20)
+
+typedef enum{
+
+    ALLOC_PAGES_AUTO,
+    ALLOC_PAGES_SMALL,
+    ALLOC_PAGES_THP,
+    ALLOC_PAGES_HUGETLB
+} alloc_pages;
+
+// A block allocated by allocBlock().
+typedef struct{
+
+    void *base;             // what to release: the calloc() block or the mapping
+    size_t size;            // the size of the mapping (0 for a calloc() block)
+    void *ptr;              // the aligned memory
+    size_t bytes;           // the number of bytes asked for
+    alloc_pages pages;      // how it was allocated (never ALLOC_PAGES_AUTO)
+} alloc_block;
+
+
+/** Select how blocks are allocated from now on. The default is ALLOC_PAGES_AUTO.*/
+void allocSetPages(alloc_pages pages);
+
+/** Look up a page policy by name ("auto", "small", "thp", or "hugetlb").
+ *  @return 0 on success, or -1 if there is no such policy
+ */
+int allocPagesFromName(const char *name, alloc_pages *pages);
+
+/** Return the name of a page policy.*/
+const char * allocPagesName(alloc_pages pages);
+
+/** Allocate a zeroed block of memory aligned to a cache line.
+ *
+ *  @param blk set to the block
+ *  @param bytes the size of the block
+ *  @return the aligned memory (also in blk->ptr), or NULL on failure
+ */
+void * allocBlock(alloc_block *blk, size_t bytes);
+
+/** Free a block. Does nothing for a block whose ptr is NULL.*/
+void allocFree(alloc_block *blk);
+
+/** Return the row stride, in elements, to use for rows of ncols elements of the given size:
+ *  rows start on a cache line, so neighboring rows in different tiles never share one,
+ *  and a stride that is a multiple of 4 KB is padded by a cache line, so the elements of a
+ *  column don't all map to the same cache set.
+ */
+int allocRowStride(int ncols, size_t entry_size);
+
+
+#endif
@@ -39,10 +39,35 @@
  * until after the barrier function runs and the mutex becomes
  * available.
  *
+ * The lock-free kinds (see barrier.h) keep the same guarantee: one
+ * thread runs the barrier function after every thread has arrived,
+ * and the others are not released until it returns.
+ *
+ * The sense barrier numbers its cycles with a ticket counter: the t-th
+ * arrival overall belongs to cycle t / threshold + 1, and the last
+ * arrival of a cycle releases it by publishing its number in the
+ * "release" word, which acts as a sense flag that counts instead of
+ * flipping, so waiters can sleep on it.
+ *
+ * The tree and dissemination barriers have no word that every
+ * participant writes. Each participant has an id (see
+ * barrier_wait_id()) and counts its own cycles in its slot, so it knows
+ * the cycle without asking anyone. Releases go out the way arrivals
+ * came in: down the tree one node at a time, or down a binary tree of
+ * slots, so each word has only a few waiters. barrier_wait() gives
+ * these kinds an id from the ticket counter: no thread can arrive for
+ * the next cycle before every thread has arrived for this one, so the
+ * ids of a cycle are always 0 .. threshold-1.
+ *
+ * Cycle numbers must stay below EPOCH_WAITERS (about a billion cycles).
  */
 #include <pthread.h>
 #include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
 #include "barrier.h"
+#include "futex.h"
 #include <stdio.h>
 
 /**
@@ -54,6 +79,52 @@
  *  be executed by the last thread to enter the barrier.
  */
 int barrier_init (barrier_t *barrier, int count, void * (* barrier_func)(void *) )
+{
+    return barrier_init_kind (barrier, count, barrier_func, BARRIER_MUTEX);
+}
+
+/*
+ * Build the combining tree: the leaves take BARRIER_TREE_FANIN
+ * arrivals each, and every other node takes one arrival from each of
+ * up to BARRIER_TREE_FANIN children. Returns 0 on success.
+ */
+static int build_tree (barrier_t *barrier, int count)
+{
+    int total = 0;
+    for (int width = count; ; width = (width + BARRIER_TREE_FANIN - 1) / BARRIER_TREE_FANIN) {
+        int level = (width + BARRIER_TREE_FANIN - 1) / BARRIER_TREE_FANIN;
+        total += level;
+        if (level == 1)
+            break;
+    }
+
+    barrier->nodes = aligned_alloc (64, total * sizeof (barrier_node));
+    if (barrier->nodes == NULL)
+        return ENOMEM;
+
+    int first = 0;          /* first node of the current level */
+    int width = count;      /* arrivals into the current level */
+    while (1) {
+        int level = (width + BARRIER_TREE_FANIN - 1) / BARRIER_TREE_FANIN;
+        for (int i = 0; i < level; i++) {
+            barrier_node *node = &barrier->nodes[first + i];
+            atomic_init (&node->count, 0);
+            atomic_init (&node->release, 0);
+            node->threshold = (width - i * BARRIER_TREE_FANIN < BARRIER_TREE_FANIN)
+                            ? width - i * BARRIER_TREE_FANIN : BARRIER_TREE_FANIN;
+            node->parent = (level == 1) ? -1 : first + level + i / BARRIER_TREE_FANIN;
+        }
+        if (level == 1)
+            break;
+        first += level;
+        width = level;
+    }
+
+    return 0;
+}
+
+int barrier_init_kind (barrier_t *barrier, int count, void * (* barrier_func)(void *),
+                       barrier_kind kind)
 {
     int status;
     // printf("Inside barrier init. Count is %d\n", count);
@@ -61,18 +132,83 @@ int barrier_init (barrier_t *barrier, int count, void * (* barrier_func)(void *)
     barrier->cycle = 0;
     barrier->barrier_func=barrier_func;
 
-    status = pthread_mutex_init (&barrier->mutex, NULL);
-    if (status != 0)
+    barrier->kind = kind;
+    atomic_init (&barrier->ticket, 0);
+    atomic_init (&barrier->release, 0);
+    barrier->nodes = NULL;
+    barrier->flags = NULL;
+    barrier->rounds = 0;
+    barrier->slots = NULL;
+
+    if (count < 1)
+        return EINVAL;
+
+    if (kind == BARRIER_TREE || kind == BARRIER_DISSEMINATION) {
+        barrier->slots = aligned_alloc (64, count * sizeof (barrier_slot));
+        if (barrier->slots == NULL)
+            return ENOMEM;
+        for (int i = 0; i < count; i++)
+            barrier->slots[i].cycle = 0;
+    }
+
+    status = 0;
+    if (kind == BARRIER_TREE) {
+        status = build_tree (barrier, count);
+    } else if (kind == BARRIER_DISSEMINATION) {
+        while ((1 << barrier->rounds) < count)
+            barrier->rounds++;
+        barrier->flags = malloc ((barrier->rounds + 1) * count * sizeof (atomic_int));
+        if (barrier->flags == NULL)
+            status = ENOMEM;
+        for (int i = 0; status == 0 && i < (barrier->rounds + 1) * count; i++)
+            atomic_init (&barrier->flags[i], 0);
+    }
+
+    if (status == 0)
+        status = pthread_mutex_init (&barrier->mutex, NULL);
+    if (status != 0) {
+        free (barrier->slots);
+        barrier->slots = NULL;
         return status;
+    }
     status = pthread_cond_init (&barrier->cv, NULL);
     if (status != 0) {
         pthread_mutex_destroy (&barrier->mutex);
+        free (barrier->nodes);
+        free (barrier->flags);
+        free (barrier->slots);
+        barrier->nodes = NULL;
+        barrier->flags = NULL;
+        barrier->slots = NULL;
         return status;
     }
     barrier->valid = BARRIER_VALID;
     return 0;
 }
 
+const char * barrier_kind_name (barrier_kind kind)
+{
+    switch (kind) {
+        case BARRIER_MUTEX:         return "mutex";
+        case BARRIER_SENSE:         return "sense";
+        case BARRIER_TREE:          return "tree";
+        case BARRIER_DISSEMINATION: return "dissemination";
+        case BARRIER_KIND_COUNT:    break;
+    }
+    return "unknown";
+}
+
+int barrier_kind_from_name (const char *name, barrier_kind *kind)
+{
+    for (int k = 0; k < BARRIER_KIND_COUNT; k++) {
+        if (strcmp (name, barrier_kind_name ((barrier_kind) k)) == 0) {
+            *kind = (barrier_kind) k;
+            return 0;
+        }
+    }
+    return -1;
+}
+
 /*
  * Destroy a barrier when done using it.
  * @param barrier a pointer to a barrier variable
@@ -102,6 +238,13 @@ int barrier_destroy (barrier_t *barrier)
     if (status != 0)
         return status;
 
+    free (barrier->nodes);
+    free (barrier->flags);
+    free (barrier->slots);
+    barrier->nodes = NULL;
+    barrier->flags = NULL;
+    barrier->slots = NULL;
+
     /*
      * If unable to destroy either 1003.1c synchronization
      * object, return the error status.
@@ -121,6 +264,131 @@ int barrier_destroy (barrier_t *barrier)
  * @param barrier_func_args a pointer that will be passed to the barrier
  *  function, if there is one.
  */
+/*
+ * Run the barrier function (if any) and release the given cycle.
+ * Returns -1, the status of the thread that did the serial work.
+ */
+static int release_cycle (barrier_t *barrier, int cycle, void * barrier_func_args)
+{
+    if (barrier->barrier_func != NULL)
+        barrier->barrier_func (barrier_func_args);
+
+    epochPublish (&barrier->release, cycle);
+    return -1;
+}
+
+/*
+ * Centralized sense-reversing barrier: the last arrival releases
+ * everyone.
+ */
+static int sense_wait (barrier_t *barrier, void * barrier_func_args)
+{
+    long t = atomic_fetch_add_explicit (&barrier->ticket, 1, memory_order_acq_rel);
+    int cycle = (int) (t / barrier->threshold) + 1;
+
+    if (t % barrier->threshold == barrier->threshold - 1)
+        return release_cycle (barrier, cycle, barrier_func_args);
+
+    epochWait (&barrier->release, cycle);
+    return 0;
+}
+
+/*
+ * Combining-tree barrier: participant id arrives at leaf
+ * id / BARRIER_TREE_FANIN, and each arrival climbs the tree until it
+ * is not the last arrival at a node, where it waits on that node's
+ * release word. The last arrival at the root runs the barrier
+ * function. Every thread, once released, releases the nodes it
+ * completed on the way up, from the top down, so each release word
+ * wakes at most BARRIER_TREE_FANIN - 1 waiters. A node's count can be
+ * cleared by its last arrival, because nobody arrives at it again
+ * until the release.
+ */
+static int tree_wait (barrier_t *barrier, int id, void * barrier_func_args)
+{
+    int cycle = ++barrier->slots[id].cycle;
+    int node = id / BARRIER_TREE_FANIN;
+    int path[BARRIER_TREE_MAX_DEPTH];   /* the nodes this thread completed */
+    int depth = 0;
+    int status;
+
+    while (1) {
+        barrier_node *n = &barrier->nodes[node];
+
+        if (atomic_fetch_add_explicit (&n->count, 1, memory_order_acq_rel) + 1 < n->threshold) {
+            epochWait (&n->release, cycle);
+            status = 0;
+            break;
+        }
+
+        atomic_store_explicit (&n->count, 0, memory_order_relaxed);
+        path[depth++] = node;
+        if (n->parent < 0) {
+            if (barrier->barrier_func != NULL)
+                barrier->barrier_func (barrier_func_args);
+            status = -1;
+            break;
+        }
+        node = n->parent;
+    }
+
+    while (depth > 0)
+        epochPublish (&barrier->nodes[path[--depth]].release, cycle);
+    return status;
+}
+
+/*
+ * Dissemination barrier: in round k, participant i signals
+ * participant i + 2^k and waits for a signal from participant i - 2^k
+ * (mod the thread count). After ceil(log2(n)) rounds every thread has
+ * heard, directly or not, from every other one. The flags hold cycle
+ * numbers, so they never need to be cleared. If there is a barrier
+ * function, participant 0 runs it and then releases the others down a
+ * binary tree: participant i is woken on its own word, and wakes
+ * participants 2i + 1 and 2i + 2.
+ */
+static int dissemination_wait (barrier_t *barrier, int id, void * barrier_func_args)
+{
+    int n = barrier->threshold;
+    int cycle = ++barrier->slots[id].cycle;
+    atomic_int *wake = &barrier->flags[barrier->rounds * n];
+
+    for (int k = 0; k < barrier->rounds; k++) {
+        epochPublish (&barrier->flags[k * n + (id + (1 << k)) % n], cycle);
+        epochWait (&barrier->flags[k * n + id], cycle);
+    }
+
+    if (barrier->barrier_func == NULL)
+        return (id == 0) ? -1 : 0;
+
+    if (id == 0)
+        barrier->barrier_func (barrier_func_args);
+    else
+        epochWait (&wake[id], cycle);
+
+    for (int c = 2 * id + 1; c <= 2 * id + 2 && c < n; c++)
+        epochPublish (&wake[c], cycle);
+    return (id == 0) ? -1 : 0;
+}
+
+int barrier_wait_id (barrier_t *barrier, int id, void * barrier_func_args)
+{
+    if (barrier->valid != BARRIER_VALID)
+        return EINVAL;
+
+    switch (barrier->kind) {
+        case BARRIER_TREE:
+        case BARRIER_DISSEMINATION:
+            if (id < 0 || id >= barrier->threshold)
+                return EINVAL;
+            if (barrier->kind == BARRIER_TREE)
+                return tree_wait (barrier, id, barrier_func_args);
+            return dissemination_wait (barrier, id, barrier_func_args);
+        default:
+            return barrier_wait (barrier, barrier_func_args);
+    }
+}
+
 int barrier_wait (barrier_t *barrier, void * barrier_func_args)
 {
     int status, cancel, cycle;
@@ -130,6 +398,20 @@ int barrier_wait (barrier_t *barrier, void * barrier_func_args)
     if (barrier->valid != BARRIER_VALID)
         return EINVAL;
 
+    switch (barrier->kind) {
+        case BARRIER_SENSE:
+            return sense_wait (barrier, barrier_func_args);
+        case BARRIER_TREE:
+        case BARRIER_DISSEMINATION: {
+            /* Without ids, the arrivals of a cycle take ids in arrival order. */
+            long t = atomic_fetch_add_explicit (&barrier->ticket, 1, memory_order_relaxed);
+            return barrier_wait_id (barrier, (int) (t % barrier->threshold),
+                                    barrier_func_args);
+        }
+        default:
+            break;
+    }
+
     status = pthread_mutex_lock (&barrier->mutex);
     if (status != 0)
         return status;
@@ -189,3 +471,67 @@ int barrier_wait (barrier_t *barrier, void * barrier_func_args)
     pthread_mutex_unlock (&barrier->mutex);
     return status;          /* error, -1 for waker, or 0 */
 }
+
+
+/*
+ * Initialize a closed gate.
+ */
+int gate_init (gate_t *gate)
+{
+    int status;
+
+    gate->state = 0;
+    status = pthread_mutex_init (&gate->mutex, NULL);
+    if (status != 0)
+        return status;
+    status = pthread_cond_init (&gate->cv, NULL);
+    if (status != 0) {
+        pthread_mutex_destroy (&gate->mutex);
+        return status;
+    }
+    return 0;
+}
+
+/*
+ * Wait until the gate is opened, and return 1 to run or 0 to exit.
+ */
+int gate_wait (gate_t *gate)
+{
+    int state;
+
+    pthread_mutex_lock (&gate->mutex);
+    while (gate->state == 0)
+        pthread_cond_wait (&gate->cv, &gate->mutex);
+    state = gate->state;
+    pthread_mutex_unlock (&gate->mutex);
+
+    return state > 0;
+}
+
+/*
+ * Open the gate, to run or to exit.
+ */
+int gate_open (gate_t *gate, int run)
+{
+    int status;
+
+    status = pthread_mutex_lock (&gate->mutex);
+    if (status != 0)
+        return status;
+    gate->state = run ? 1 : -1;
+    status = pthread_cond_broadcast (&gate->cv);
+    pthread_mutex_unlock (&gate->mutex);
+    return status;
+}
+
+/*
+ * Destroy a gate.
+ */
+int gate_destroy (gate_t *gate)
+{
+    int status, status2;
+
+    status = pthread_cond_destroy (&gate->cv);
+    status2 = pthread_mutex_destroy (&gate->mutex);
+    return (status != 0 ? status : status2);
+}
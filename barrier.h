@@ -24,9 +24,62 @@
  * all "reached" the barrier. The number of threads required is
  * set when the barrier is initialized, and cannot be changed
  * except by reinitializing.
+ *
+ * Several implementations are available behind the same API, chosen
+ * when the barrier is initialized with barrier_init_kind():
+ *
+ *      BARRIER_MUTEX           one mutex and condition variable (the original)
+ *      BARRIER_SENSE           a centralized sense-reversing barrier
+ *      BARRIER_TREE            a combining tree of counters
+ *      BARRIER_DISSEMINATION   a dissemination barrier
+ *
+ * The last three never take a lock. Waiters spin on an atomic word and
+ * then sleep on it with a futex (see futex.h).
+ *
+ * The tree and dissemination barriers are best used through
+ * barrier_wait_id(), where each participant names itself with an id
+ * from 0 to count-1. The id picks its leaf of the tree or its partners,
+ * so no word is shared by all of them. Through barrier_wait() they
+ * hand out the ids with a shared ticket counter instead. All of the
+ * participants of a barrier must use the same one of the two.
  */
 #include <pthread.h>
+#include <stdatomic.h>
+
+
+typedef enum{
+
+    BARRIER_MUTEX,
+    BARRIER_SENSE,
+    BARRIER_TREE,
+    BARRIER_DISSEMINATION,
+
+    BARRIER_KIND_COUNT                  // number of kinds; not a kind
+} barrier_kind;
+
+// Each node of a combining tree gathers this many arrivals.
+#define BARRIER_TREE_FANIN 4
+
+/*
+ * A node of a combining tree.
+ */
+typedef struct{
+    _Alignas(64) atomic_int count;      /* arrivals in this cycle */
+    int                 threshold;      /* arrivals that complete the node */
+    int                 parent;         /* index of the parent, or -1 */
+    _Alignas(64) atomic_int release;    /* the last cycle released at this node */
+} barrier_node;
+
+// The most levels a combining tree can have (BARRIER_TREE_FANIN^16 > INT_MAX).
+#define BARRIER_TREE_MAX_DEPTH 16
 
+/*
+ * The state of one participant of a tree or dissemination barrier,
+ * written only by that participant.
+ */
+typedef struct{
+    _Alignas(64) int    cycle;          /* the cycles this participant has entered */
+} barrier_slot;
 
 /*
  * Structure describing a barrier.
@@ -40,6 +93,15 @@ typedef struct barrier_tag {
     int                 cycle;          /* alternate wait cycles (0 or 1) */
     void * (* barrier_func)(void *);    // A function executed by the waking thread
                                         // under the protection of the barrier mutex.
+
+    barrier_kind        kind;
+    atomic_long         ticket;         /* arrivals so far, over all cycles */
+    atomic_int          release;        /* number of the last completed cycle */
+    barrier_node        *nodes;         /* combining tree, leaves first */
+    atomic_int          *flags;         /* dissemination: rounds x threshold words, then
+                                           threshold release words */
+    int                 rounds;         /* dissemination: ceil(log2(threshold)) */
+    barrier_slot        *slots;         /* tree and dissemination: one per participant */
 } barrier_t;
 
 #define BARRIER_VALID   0xdbcafe
@@ -56,6 +118,32 @@ typedef struct barrier_tag {
  */
 int barrier_init(barrier_t *barrier, int count, void * (* barrier_func)(void *) );
 
+/**
+ * Initialize a barrier of the given kind for use. barrier_init() is
+ * the same as barrier_init_kind() with BARRIER_MUTEX.
+ *
+ * @param barrier a pointer to a barrier variable
+ * @param count the number of threads that will participate in this barrier
+ * @param barrier_func a function pointer referring to a "barrier function" that will
+ *  be executed by one thread once all threads have entered the barrier, before any
+ *  of them leaves it.
+ * @param kind the implementation to use
+ */
+int barrier_init_kind(barrier_t *barrier, int count, void * (* barrier_func)(void *),
+                      barrier_kind kind);
+
+/*
+ * Return the name of a barrier kind ("mutex", "sense", "tree" or
+ * "dissemination").
+ */
+const char * barrier_kind_name(barrier_kind kind);
+
+/*
+ * Look up a barrier kind by name. Returns 0 on success, or -1 if
+ * there is no such kind.
+ */
+int barrier_kind_from_name(const char *name, barrier_kind *kind);
+
 
 /*
  * Destroy a barrier when done using it.
@@ -75,5 +163,54 @@ int barrier_destroy(barrier_t *barrier);
  */
 int barrier_wait(barrier_t *barrier, void * barrier_func_args);
 
+/**
+ * Wait at a barrier as participant id, like barrier_wait(). The tree
+ * and dissemination barriers use the id to find their place without a
+ * shared counter; the other kinds ignore it.
+ *
+ * @param barrier a barrier variable
+ * @param id this participant, from 0 to count-1, the same in every cycle
+ *  and different from every other participant's
+ * @param barrier_func_args a pointer that will be passed to the barrier
+ *  function, if there is one.
+ */
+int barrier_wait_id(barrier_t *barrier, int id, void * barrier_func_args);
+
+
+/*
+ * A start gate holds newly created threads back until the thread that
+ * creates them knows whether all of them could be created. A thread
+ * pool whose barrier counts every worker starts them behind a gate, so
+ * that if pthread_create() fails part way, the workers already running
+ * can be sent home instead of waiting at the barrier forever.
+ */
+typedef struct {
+    pthread_mutex_t     mutex;
+    pthread_cond_t      cv;
+    int                 state;          /* 0 until opened, then 1 (run) or -1 (exit) */
+} gate_t;
+
+/*
+ * Initialize a closed gate.
+ */
+int gate_init(gate_t *gate);
+
+/*
+ * Wait until the gate is opened. Returns 1 if the thread is to run, or
+ * 0 if it is to exit without touching anything it shares.
+ */
+int gate_wait(gate_t *gate);
+
+/*
+ * Open the gate, waking every thread waiting at it.
+ * @param run non-zero to let the threads run, or 0 to tell them to exit
+ */
+int gate_open(gate_t *gate, int run);
+
+/*
+ * Destroy a gate. No thread may still be waiting at it.
+ */
+int gate_destroy(gate_t *gate);
+
 
 #endif
@@ -0,0 +1,422 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "report.h"
+#include "value.h"
+#include "stencil.h"
+#include "wavefront.h"
+
+/** The benchmark harness runs the engines through wavefront(), with the results recorded
+ *  by report.c instead of printed. The latency of round r is the time between the
+ *  completion of round r-1 (or the start of the run, for round 0) and the completion of
+ *  round r, so round 0 also includes the engine's startup. That latency is also reported on
+ *  its own as the time to the first round.
+ *
+ *  Parallel efficiency is T(1) / (p * T(p)), where T(p) is the wall time of the same engine,
+ *  grid, and repetition count on p threads. It is only reported for engines that use a
+ *  worker pool, and only when the thread list includes 1; that count is run first.
+ */
+
+
+
+// The per-element engines create one thread per interior element. Larger grids are
+// skipped rather than running into the process limit.
+#define BENCH_MAX_CELL_THREADS 4096
+
+#define BENCH_MAX_LIST 32
+
+
+// A parsed comma-separated list.
+typedef struct{
+
+    int n;
+    int a[BENCH_MAX_LIST];     // the values, or the rows for a grid list
+    int b[BENCH_MAX_LIST];     // the columns, for a grid list
+} bench_list;
+
+
+// The measurements from one run.
+typedef struct{
+
+    double wall_sec;
+    double first_ms;           // time to the first round's result, startup included
+    double p50_ms, p90_ms, p99_ms, max_ms;
+    int consistent;            // every round produced the same value
+    value_t result;
+} bench_result;
+
+
+
+/** Parse a comma-separated list of integers, or of ROWSxCOLS pairs if grid is non-zero.
+ *  @return 0 on success, or -1 if the list is malformed
+ */
+static int parseList(const char *arg, int grid, bench_list *list){
+
+    list->n = 0;
+
+    const char *p = arg;
+    while(*p != '\0' && list->n < BENCH_MAX_LIST){
+
+        char *end;
+        list->a[list->n] = (int) strtol(p, &end, 10);
+        if(end == p){
+            return -1;
+        }
+        p = end;
+
+        if(grid){
+            if(*p != 'x'){
+                return -1;
+            }
+            p++;
+            list->b[list->n] = (int) strtol(p, &end, 10);
+            if(end == p){
+                return -1;
+            }
+            p = end;
+        }
+
+        list->n++;
+
+        if(*p == ','){
+            p++;
+        } else if(*p != '\0'){
+            return -1;
+        }
+    }
+
+    if(*p != '\0'){
+        fprintf(stderr, "bench: too many entries (at most %d)\n", BENCH_MAX_LIST);
+        return -1;
+    }
+
+    return list->n > 0 ? 0 : -1;
+}
+
+
+static int compareDoubles(const void *a, const void *b){
+
+    double x = *(const double *) a;
+    double y = *(const double *) b;
+
+    return (x > y) - (x < y);
+}
+
+
+/** Return the nearest-rank percentile of a sorted array.*/
+static double percentile(const double *sorted, int n, double pct){
+
+    int rank = (int)(pct / 100.0 * n + 0.999999);
+    if(rank < 1) rank = 1;
+    if(rank > n) rank = n;
+
+    return sorted[rank - 1];
+}
+
+
+/** Return non-zero if the engine's thread count comes from engine_opts.num_threads.*/
+static int usesPool(engine_kind engine){
+
+    return engine == ENGINE_TILED || engine == ENGINE_RECURSIVE;
+}
+
+
+/** Return non-zero if the engine creates one thread per interior element.*/
+static int usesCellThreads(engine_kind engine){
+
+    return engine == ENGINE_CELL || engine == ENGINE_PIPELINE;
+}
+
+
+/** Run one engine configuration and measure it.
+ *  @return 0 on success, or an error code from the engine
+ */
+static int runOne(int rows, int cols, int reps, const engine_opts *opts, bench_result *res){
+
+    if(reps < 1 || rows < 1 || cols < 1){
+        return EXIT_FAILURE;
+    }
+
+    value_t *values = calloc(reps, sizeof(value_t));
+    double *times = malloc(reps * sizeof(double));
+    double *lat = malloc(reps * sizeof(double));
+
+    reportRecord(values, times, reps);
+
+    double start = reportNow();
+    int status = wavefront(rows, cols, reps, opts);
+    double end = reportNow();
+
+    reportPrint();
+
+    res->wall_sec = end - start;
+    res->first_ms = (times[0] - start) * 1e3;
+    res->result = values[0];
+    res->consistent = 1;
+
+    for(int r=0; r < reps; r++){
+
+        lat[r] = (times[r] - (r == 0 ? start : times[r - 1])) * 1e3;
+        if(values[r] != values[0]){
+            res->consistent = 0;
+        }
+    }
+
+    qsort(lat, reps, sizeof(double), compareDoubles);
+    res->p50_ms = percentile(lat, reps, 50);
+    res->p90_ms = percentile(lat, reps, 90);
+    res->p99_ms = percentile(lat, reps, 99);
+    res->max_ms = lat[reps - 1];
+
+    free(values);
+    free(times);
+    free(lat);
+
+    return status;
+}
+
+
+static void writeHeader(FILE *out, int json){
+
+    if(json){
+        fprintf(out, "[\n");
+    } else {
+        fprintf(out, "engine,rows,cols,threads,reps,value_type,wall_sec,first_round_ms,p50_round_ms,"
+                     "p90_round_ms,p99_round_ms,max_round_ms,cells_per_sec,efficiency,"
+                     "result,consistent\n");
+    }
+}
+
+
+static void writeRecord(FILE *out, int json, int first, engine_kind engine, int rows, int cols,
+                        int threads, int reps, const bench_result *res, double efficiency){
+
+    double cells = (double)(rows - 1) * (cols - 1) * reps;
+    double cells_per_sec = res->wall_sec > 0 ? cells / res->wall_sec : 0.0;
+
+    char value[VALUE_STR_LEN];
+    valueToString(res->result, value);
+
+    char eff[32];
+    if(efficiency >= 0){
+        snprintf(eff, sizeof(eff), "%.4f", efficiency);
+    } else {
+        strcpy(eff, json ? "null" : "");
+    }
+
+    if(json){
+        fprintf(out, "%s  {\"engine\": \"%s\", \"rows\": %d, \"cols\": %d, \"threads\": %d, "
+                     "\"reps\": %d, \"value_type\": \"%s\", \"wall_sec\": %.6f, \"first_round_ms\": %.6f, "
+                     "\"p50_round_ms\": %.6f, \"p90_round_ms\": %.6f, \"p99_round_ms\": %.6f, "
+                     "\"max_round_ms\": %.6f, \"cells_per_sec\": %.1f, \"efficiency\": %s, "
+                     "\"result\": \"%s\", \"consistent\": %s}",
+                first ? "" : ",\n", engineName(engine), rows, cols, threads, reps,
+                valueTypeName(), res->wall_sec, res->first_ms, res->p50_ms, res->p90_ms, res->p99_ms,
+                res->max_ms, cells_per_sec, eff, value, res->consistent ? "true" : "false");
+    } else {
+        fprintf(out, "%s,%d,%d,%d,%d,%s,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f,%.1f,%s,%s,%d\n",
+                engineName(engine), rows, cols, threads, reps, valueTypeName(), res->wall_sec,
+                res->first_ms, res->p50_ms, res->p90_ms, res->p99_ms, res->max_ms, cells_per_sec, eff, value,
+                res->consistent);
+    }
+
+    fflush(out);
+}
+
+
+static void usage(){
+
+    fprintf(stderr, "Usage: ./a3 bench [-e engines] [-g ROWSxCOLS,...] [-t threads,...] "
+                    "[-r reps,...] [-f csv|json] [-o file]\n");
+}
+
+
+int benchMain(int argc, char *argv[]){
+
+    int online = (int) sysconf(_SC_NPROCESSORS_ONLN);
+
+    engine_kind engines[ENGINE_COUNT];
+    int num_engines = 0;
+    for(int e=0; e < ENGINE_COUNT; e++){
+#ifndef STENCIL_DELANNOY
+        if(e == ENGINE_CLOSED){
+            continue;
+        }
+#endif
+        if(e != ENGINE_AUTO){
+            engines[num_engines++] = (engine_kind) e;
+        }
+    }
+
+    bench_list grids, threads, reps;
+    parseList("32x32,256x256,1024x1024", 1, &grids);
+    parseList("10", 0, &reps);
+    threads.n = 0;
+    for(int t=1; t <= online && threads.n < BENCH_MAX_LIST; t *= 2){
+        threads.a[threads.n++] = t;
+    }
+    if(threads.a[threads.n - 1] != online && threads.n < BENCH_MAX_LIST){
+        threads.a[threads.n++] = online;
+    }
+
+    int json = 0;
+    const char *out_path = NULL;
+
+    optind = 1;
+    int opt;
+    while((opt = getopt(argc, argv, "e:g:t:r:f:o:")) != -1){
+
+        switch(opt){
+
+            case 'e': {
+                num_engines = 0;
+                char *list = strdup(optarg);
+                for(char *tok = strtok(list, ","); tok != NULL; tok = strtok(NULL, ",")){
+
+                    engine_kind engine;
+                    if(engineFromName(tok, &engine) != 0 || engine == ENGINE_AUTO){
+                        fprintf(stderr, "Unknown engine: %s\n", tok);
+                        free(list);
+                        return EXIT_FAILURE;
+                    }
+
+                    // Every engine but auto can be listed once, so the list can't overflow.
+                    for(int e=0; e < num_engines; e++){
+                        if(engines[e] == engine){
+                            fprintf(stderr, "Engine listed twice: %s\n", tok);
+                            free(list);
+                            return EXIT_FAILURE;
+                        }
+                    }
+                    engines[num_engines++] = engine;
+                }
+                free(list);
+                break;
+            }
+
+            case 'g':
+            case 't':
+            case 'r':
+                if(parseList(optarg, opt == 'g',
+                             opt == 'g' ? &grids : (opt == 't' ? &threads : &reps)) != 0){
+                    fprintf(stderr, "Bad list: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+
+            case 'f':
+                if(strcmp(optarg, "json") == 0){
+                    json = 1;
+                } else if(strcmp(optarg, "csv") != 0){
+                    usage();
+                    return EXIT_FAILURE;
+                }
+                break;
+
+            case 'o':
+                out_path = optarg;
+                break;
+
+            default:
+                usage();
+                return EXIT_FAILURE;
+        }
+    }
+
+    FILE *out = stdout;
+    if(out_path != NULL && (out = fopen(out_path, "w")) == NULL){
+        perror(out_path);
+        return EXIT_FAILURE;
+    }
+
+    writeHeader(out, json);
+    int first = 1;
+    int status = EXIT_SUCCESS;
+
+    for(int e=0; e < num_engines; e++){
+        for(int g=0; g < grids.n; g++){
+            for(int r=0; r < reps.n; r++){
+
+                int rows = grids.a[g], cols = grids.b[g];
+
+                if(usesCellThreads(engines[e]) &&
+                   (long)(rows - 1) * (cols - 1) > BENCH_MAX_CELL_THREADS){
+                    fprintf(stderr, "bench: skipping %s on %dx%d (more than %d threads)\n",
+                            engineName(engines[e]), rows, cols, BENCH_MAX_CELL_THREADS);
+                    continue;
+                }
+
+                // Engines without a pool run once, with the thread count they choose.
+                int num_threads = usesPool(engines[e]) ? threads.n : 1;
+                double t1 = -1;
+
+                // The efficiencies need T(1), so a count of 1 runs first, wherever it is
+                // in the list: order[] swaps it with the first entry.
+                int order[BENCH_MAX_LIST];
+                for(int t=0; t < threads.n; t++){
+                    order[t] = t;
+                }
+                for(int t=1; t < threads.n; t++){
+                    if(threads.a[t] == 1 && threads.a[0] != 1){
+                        order[0] = t;
+                        order[t] = 0;
+                        break;
+                    }
+                }
+
+                for(int i=0; i < num_threads; i++){
+
+                    int t = order[i];
+
+                    engine_opts opts;
+                    defaultEngineOpts(&opts);
+                    opts.engine = engines[e];
+
+                    int p = 1;
+                    if(usesPool(engines[e])){
+                        p = threads.a[t];
+                        opts.num_threads = p;
+                    } else if(usesCellThreads(engines[e])){
+                        p = (rows - 1) * (cols - 1);
+                    }
+
+                    bench_result res;
+                    if(runOne(rows, cols, reps.a[r], &opts, &res) != 0){
+                        fprintf(stderr, "bench: %s failed on %dx%d\n",
+                                engineName(engines[e]), rows, cols);
+                        status = EXIT_FAILURE;
+                        continue;
+                    }
+
+                    double eff = -1;
+                    if(usesPool(engines[e])){
+                        if(p == 1){
+                            t1 = res.wall_sec;
+                        }
+                        if(t1 > 0){
+                            eff = t1 / (p * res.wall_sec);
+                        }
+                    }
+
+                    writeRecord(out, json, first, engines[e], rows, cols, p, reps.a[r], &res, eff);
+                    first = 0;
+                }
+            }
+        }
+    }
+
+    if(json){
+        fprintf(out, "\n]\n");
+    }
+
+    if(out != stdout){
+        fclose(out);
+    }
+
+    return status;
+}
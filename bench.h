@@ -0,0 +1,24 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+/** Run the benchmark harness. Each selected engine is run over every combination of grid
+ *  size, thread count, and repetition count, and one record per run is written as CSV or
+ *  JSON with the wall time, the time to the first round (startup included), per-round
+ *  latency percentiles, cells per second, and parallel efficiency.
+ *
+ *  Usage: ./a3 bench [-e engines] [-g grids] [-t threads] [-r reps] [-f csv|json] [-o file]
+ *      -e a comma-separated list of engines, each at most once (default: every engine)
+ *      -g a comma-separated list of grid sizes, as ROWSxCOLS
+ *      -t a comma-separated list of thread counts, for the engines that use a pool
+ *      -r a comma-separated list of repetition counts
+ *      -f the output format (default: csv)
+ *      -o the output file (default: stdout)
+ *
+ *  @param argc argument count, where argv[0] is "bench"
+ *  @param argv argument vector
+ *  @return 0 on success, or an error code
+ */
+int benchMain(int argc, char *argv[]);
+
+
+#endif
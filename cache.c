@@ -0,0 +1,240 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "cache.h"
+#include "value.h"
+#include "stencil.h"
+
+/** The cache file is a header followed by CACHE_CAPACITY entries. An entry goes from
+ *  empty to being written to full, and never back, so a reader that sees it full can read
+ *  its key and value without a lock.
+ */
+
+
+
+#define CACHE_MAGIC "WFCACHE1"
+
+enum{ ENTRY_EMPTY, ENTRY_WRITING, ENTRY_FULL };
+
+
+typedef struct{
+
+    char magic[8];
+    uint32_t capacity;
+    uint32_t entry_size;
+} cache_header;
+
+
+typedef struct{
+
+    atomic_uint state;
+    int32_t rows, cols;
+    uint64_t tag;                       // hash of valueTypeName() and STENCIL_NAME
+    unsigned char value[16];            // a value_t, in the writer's byte order
+} cache_entry;
+
+
+typedef struct{
+
+    cache_header header;
+    cache_entry entries[CACHE_CAPACITY];
+} cache_table;
+
+
+
+// These variables have "static" scope. There is only one cache per process.
+static cache_table * table = NULL;
+static int mapped = 0;              // the table is a mapped file, not malloc'd memory
+static uint64_t type_tag = 0;
+static int open_count = 0;             // cacheOpen() calls not yet matched by cacheClose()
+
+
+
+/** FNV-1a hash of a string.*/
+static uint64_t hashString(const char *s){
+
+    uint64_t h = 14695981039346656037ULL;
+    for(; *s != '\0'; s++){
+        h = (h ^ (unsigned char) *s) * 1099511628211ULL;
+    }
+
+    return h;
+}
+
+
+static unsigned int slotOf(int rows, int cols){
+
+    uint64_t h = type_tag ^ ((uint64_t)(uint32_t) rows * 0x9E3779B97F4A7C15ULL)
+                          ^ ((uint64_t)(uint32_t) cols * 0xC2B2AE3D27D4EB4FULL);
+
+    return (unsigned int)(h ^ (h >> 29)) % CACHE_CAPACITY;
+}
+
+
+/** Map a cache file, creating and formatting it if it is empty.
+ *  @return 0 on success, or -1 on failure
+ */
+static int mapFile(const char *path){
+
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if(fd < 0){
+        perror(path);
+        return -1;
+    }
+
+    struct stat st;
+    if(fstat(fd, &st) != 0 ||
+       (st.st_size == 0 && ftruncate(fd, sizeof(cache_table)) != 0)){
+        perror(path);
+        close(fd);
+        return -1;
+    }
+
+    if(st.st_size != 0 && (size_t) st.st_size != sizeof(cache_table)){
+        fprintf(stderr, "%s: not a cache file\n", path);
+        close(fd);
+        return -1;
+    }
+
+    void *p = mmap(NULL, sizeof(cache_table), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(p == MAP_FAILED){
+        perror(path);
+        return -1;
+    }
+
+    cache_table *t = p;
+
+    // A new file reads as zeros, which is an empty table apart from the header. Two
+    // processes formatting it at once write the same bytes.
+    if(t->header.magic[0] == '\0'){
+        t->header.capacity = CACHE_CAPACITY;
+        t->header.entry_size = sizeof(cache_entry);
+        memcpy(t->header.magic, CACHE_MAGIC, sizeof(t->header.magic));
+    }
+
+    if(memcmp(t->header.magic, CACHE_MAGIC, sizeof(t->header.magic)) != 0 ||
+       t->header.capacity != CACHE_CAPACITY || t->header.entry_size != sizeof(cache_entry)){
+        fprintf(stderr, "%s: not a cache file\n", path);
+        munmap(p, sizeof(cache_table));
+        return -1;
+    }
+
+    table = t;
+    mapped = 1;
+
+    return 0;
+}
+
+
+int cacheOpen(const char *path){
+
+    if(table != NULL){
+        open_count++;
+        return 0;
+    }
+
+    type_tag = hashString(valueTypeName()) ^ (hashString(STENCIL_NAME) * 0x9E3779B97F4A7C15ULL);
+
+    if(path != NULL){
+        if(mapFile(path) != 0){
+            return -1;
+        }
+        open_count = 1;
+        return 0;
+    }
+
+    table = calloc(1, sizeof(cache_table));
+    mapped = 0;
+    if(table == NULL){
+        return -1;
+    }
+
+    open_count = 1;
+    return 0;
+}
+
+
+int cacheLookup(int rows, int cols, value_t *result){
+
+    if(table == NULL){
+        return 0;
+    }
+
+    unsigned int slot = slotOf(rows, cols);
+
+    for(int p=0; p < CACHE_PROBES; p++){
+
+        cache_entry *e = &table->entries[(slot + p) % CACHE_CAPACITY];
+        unsigned int state = atomic_load_explicit(&e->state, memory_order_acquire);
+
+        if(state == ENTRY_EMPTY){
+            return 0;
+        }
+        if(state == ENTRY_FULL && e->rows == rows && e->cols == cols && e->tag == type_tag){
+            memcpy(result, e->value, sizeof(value_t));
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+
+void cacheStore(int rows, int cols, value_t result){
+
+    if(table == NULL){
+        return;
+    }
+
+    unsigned int slot = slotOf(rows, cols);
+
+    for(int p=0; p < CACHE_PROBES; p++){
+
+        cache_entry *e = &table->entries[(slot + p) % CACHE_CAPACITY];
+        unsigned int state = atomic_load_explicit(&e->state, memory_order_acquire);
+
+        if(state == ENTRY_FULL && e->rows == rows && e->cols == cols && e->tag == type_tag){
+            return;
+        }
+
+        unsigned int empty = ENTRY_EMPTY;
+        if(state == ENTRY_EMPTY &&
+           atomic_compare_exchange_strong_explicit(&e->state, &empty, ENTRY_WRITING,
+                                                   memory_order_acquire, memory_order_relaxed)){
+            e->rows = rows;
+            e->cols = cols;
+            e->tag = type_tag;
+            memset(e->value, 0, sizeof(e->value));
+            memcpy(e->value, &result, sizeof(value_t));
+
+            atomic_store_explicit(&e->state, ENTRY_FULL, memory_order_release);
+            return;
+        }
+    }
+}
+
+
+void cacheClose(){
+
+    if(table == NULL || --open_count > 0){
+        return;
+    }
+
+    if(mapped){
+        munmap(table, sizeof(cache_table));
+    } else {
+        free(table);
+    }
+
+    table = NULL;
+}
@@ -0,0 +1,51 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include "value.h"
+
+/*
+ * cache.h
+ *
+ * A cache of results keyed by grid shape. Every round of a computation, and every run of
+ * the same shape, produces the same result, so a result found here can be reported
+ * without running the wavefront at all. Keys also include the value type (and modulus,
+ * see valueTypeName()) and the stencil (see stencil.h), so binaries built with different
+ * VALUE or STENCIL settings can share a file.
+ *
+ * The cache is a fixed-size open-addressed hash table. It lives either in private memory
+ * or in a file mapped with MAP_SHARED, so that concurrent processes see each other's
+ * results. Each entry is published with an atomic state word, and a full neighborhood of
+ * probes simply drops the new result, so no locking is needed across processes.
+ */
+
+// Number of entries in the table, and entries probed per lookup.
+#define CACHE_CAPACITY 4096
+#define CACHE_PROBES 32
+
+
+/** Open the cache, if it isn't open already. A file that doesn't exist is created. Every
+ *  successful call must be matched by a cacheClose(), and the cache stays open (on the
+ *  file of the first call) until the last one.
+ *
+ *  @param path the file to map, or NULL to keep the cache in memory
+ *  @return 0 on success, or -1 if the file couldn't be opened or isn't a cache file
+ */
+int cacheOpen(const char *path);
+
+/** Look up the result for a grid shape.
+ *
+ *  @param rows number of rows in the state array
+ *  @param cols number of columns in the state array
+ *  @param result set to the cached result, on a hit
+ *  @return 1 on a hit, or 0 on a miss or if the cache isn't open
+ */
+int cacheLookup(int rows, int cols, value_t *result);
+
+/** Store the result for a grid shape. Does nothing if the cache isn't open.*/
+void cacheStore(int rows, int cols, value_t result);
+
+/** Unmap or free the cache, if this matches the last open cacheOpen().*/
+void cacheClose();
+
+
+#endif
@@ -0,0 +1,234 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "closed.h"
+#include "value.h"
+#include "stencil.h"
+#include "report.h"
+
+/** The sums live in Z/M, where M is 2^VALUE_BITS for the wrapping types and VALUE_MODULUS
+ *  for VALUE_MOD. Building C(m, k) one k at a time, as C(m, k-1) * (m-k+1) / k, needs a
+ *  division, and k only has an inverse mod M if it shares no prime with M.
+ *
+ *  So each binomial is kept as a unit times powers of the primes of M that can occur in a
+ *  denominator: the primes of M up to min(m, n). Those primes are divided out of every
+ *  numerator and denominator and only counted, what is left of a denominator is coprime to
+ *  M and is inverted, and what is left of a numerator is multiplied in. For the wrapping
+ *  types the only such prime is 2, and the inverse of an odd number mod 2^VALUE_BITS comes
+ *  from Newton's iteration. For VALUE_MOD the primes are found by trial division up to
+ *  min(m, n), and the inverse comes from the extended Euclidean algorithm.
+ *
+ *  So each of the min(m, n) terms costs more than a multiplication: an inverse (6 Newton
+ *  steps, or O(log VALUE_MODULUS) Euclidean steps), the trial divisions that strip the
+ *  primes from its numerator and denominator, and a power of each prime, O(log min(m, n))
+ *  multiplications apiece. With one prime and a constant-time inverse for the wrapping
+ *  types, the sum takes O(min(m, n) log min(m, n)) multiplications.
+ */
+
+
+
+#if defined(VALUE_MOD)
+
+// The number of distinct primes of a modulus below 2^62 is at most 15.
+#define RING_MAX_PRIMES 16
+
+static uvalue_t ringMul(uvalue_t a, uvalue_t b){
+
+    __extension__ unsigned __int128 p = (unsigned __int128) a * b;
+    return (uvalue_t)(p % VALUE_MODULUS);
+}
+
+static uvalue_t ringAdd(uvalue_t a, uvalue_t b){
+
+    uvalue_t s = a + b;
+    return s >= VALUE_MODULUS ? s - VALUE_MODULUS : s;
+}
+
+static uvalue_t ringFrom(long x){
+
+    return (uvalue_t) x % VALUE_MODULUS;
+}
+
+/** Return the inverse of a unit, by the extended Euclidean algorithm.*/
+static uvalue_t ringInv(uvalue_t a){
+
+    int64_t t = 0, new_t = 1;
+    int64_t r = (int64_t) VALUE_MODULUS, new_r = (int64_t) a;
+
+    while(new_r != 0){
+
+        int64_t q = r / new_r, tmp;
+
+        tmp = t - q * new_t;
+        t = new_t;
+        new_t = tmp;
+
+        tmp = r - q * new_r;
+        r = new_r;
+        new_r = tmp;
+    }
+
+    return (uvalue_t)(t < 0 ? t + (int64_t) VALUE_MODULUS : t);
+}
+
+/** Find the primes of the modulus that are at most k.
+ *  @return the number of primes stored in primes
+ */
+static int ringPrimes(long k, long *primes){
+
+    int n = 0;
+    uvalue_t rest = VALUE_MODULUS;
+
+    for(long d=2; d <= k && rest > 1; d++){
+
+        if(rest % (uvalue_t) d == 0){
+            primes[n++] = d;
+            while(rest % (uvalue_t) d == 0){
+                rest /= (uvalue_t) d;
+            }
+        }
+    }
+
+    return n;
+}
+
+#else
+
+#define RING_MAX_PRIMES 1
+
+static uvalue_t ringMul(uvalue_t a, uvalue_t b){
+
+    return a * b;
+}
+
+static uvalue_t ringAdd(uvalue_t a, uvalue_t b){
+
+    return a + b;
+}
+
+static uvalue_t ringFrom(long x){
+
+    return (uvalue_t) x;
+}
+
+/** Return the inverse of an odd number. Each step doubles the number of correct low bits,
+ *  starting from 3 (a * a = 1 mod 8 for odd a), so 6 steps cover 128 bits.
+ */
+static uvalue_t ringInv(uvalue_t a){
+
+    uvalue_t x = a;
+    for(int i=0; i < 6; i++){
+        x *= 2 - a * x;
+    }
+
+    return x;
+}
+
+static int ringPrimes(long k, long *primes){
+
+    (void) k;
+    primes[0] = 2;
+    return 1;
+}
+
+#endif
+
+
+static uvalue_t ringPow(uvalue_t base, long e){
+
+    uvalue_t r = ringFrom(1);
+
+    for(; e > 0; e >>= 1){
+        if(e & 1){
+            r = ringMul(r, base);
+        }
+        base = ringMul(base, base);
+    }
+
+    return r;
+}
+
+
+
+// A binomial coefficient, as unit * product of primes[i]^exps[i].
+typedef struct{
+
+    uvalue_t unit;
+    long exps[RING_MAX_PRIMES];
+} binomial;
+
+
+/** Multiply a binomial by num / den, where the quotient is known to keep it an integer.*/
+static void binomialStep(binomial *b, long num, long den, const long *primes, int num_primes){
+
+    for(int i=0; i < num_primes; i++){
+
+        for(; num % primes[i] == 0; num /= primes[i]){
+            b->exps[i]++;
+        }
+        for(; den % primes[i] == 0; den /= primes[i]){
+            b->exps[i]--;
+        }
+    }
+
+    b->unit = ringMul(b->unit, ringFrom(num));
+    b->unit = ringMul(b->unit, ringInv(ringFrom(den)));
+}
+
+
+static uvalue_t binomialValue(const binomial *b, const long *primes, int num_primes){
+
+    uvalue_t v = b->unit;
+    for(int i=0; i < num_primes; i++){
+        v = ringMul(v, ringPow(ringFrom(primes[i]), b->exps[i]));
+    }
+
+    return v;
+}
+
+
+
+value_t closedResult(int num_state_rows, int num_state_cols){
+
+    long m = num_state_rows - 1;
+    long n = num_state_cols - 1;
+    long k_max = m < n ? m : n;
+
+    long primes[RING_MAX_PRIMES];
+    int num_primes = ringPrimes(k_max, primes);
+
+    binomial cm = { ringFrom(1), { 0 } };
+    binomial cn = { ringFrom(1), { 0 } };
+    uvalue_t pow2 = ringFrom(1);
+    uvalue_t sum = ringFrom(1);         // the k = 0 term
+
+    for(long k=1; k <= k_max; k++){
+
+        binomialStep(&cm, m - k + 1, k, primes, num_primes);
+        binomialStep(&cn, n - k + 1, k, primes, num_primes);
+        pow2 = ringMul(pow2, ringFrom(2));
+
+        uvalue_t term = ringMul(binomialValue(&cm, primes, num_primes),
+                                binomialValue(&cn, primes, num_primes));
+        sum = ringAdd(sum, ringMul(term, pow2));
+    }
+
+    return (value_t) sum;
+}
+
+
+int closedWavefront(int num_state_rows, int num_state_cols, int numRounds, const engine_opts *opts){
+
+    (void) opts;
+
+#ifndef STENCIL_DELANNOY
+    fprintf(stderr, "closed: the %s stencil has no closed form\n", STENCIL_NAME);
+    return EXIT_FAILURE;
+#endif
+
+    for(int round=0; round < numRounds; round++){
+        reportRound(round, closedResult(num_state_rows, num_state_cols));
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,35 @@
+#ifndef CLOSED_H
+#define CLOSED_H
+
+#include "value.h"
+#include "wavefront.h"
+
+/** Compute the result without a wavefront. With all-ones borders, element 0 of an
+ *  nrows x ncols array is the Delannoy number D(m, n) with m = nrows - 1 and n = ncols - 1,
+ *
+ *      D(m, n) = sum over k = 0 .. min(m, n) of C(m, k) * C(n, k) * 2^k
+ *
+ *  which takes min(nrows, ncols) terms instead of O(nrows * ncols) additions. Each term costs
+ *  a modular inverse and a power of each prime of the modulus up to min(nrows, ncols), so
+ *  the whole sum takes O(min(nrows, ncols) * log(min(nrows, ncols))) multiplications with
+ *  the wrapping types, and a factor of the modulus's primes and of log(VALUE_MODULUS) more
+ *  with VALUE_MOD (see closed.c).
+ *  The sum is evaluated in the selected value type, so the result is the same as the
+ *  other engines', wraparound and modulus included.
+ *
+ *  Only element 0 is computed, so this engine can't answer other shapes from the same run
+ *  (see wavefrontBatch()). It fails in builds for any other stencil than the default one
+ *  (see stencil.h). See wavefront() for the parameters.
+ */
+int closedWavefront(int num_state_rows, int num_state_cols, int numRounds, const engine_opts *opts);
+
+/** Return the result (element 0) for an array of the given shape.
+ *
+ *  @param num_state_rows number of rows in the state array
+ *  @param num_state_cols number of columns in the state array
+ *  @return the sum of element 0
+ */
+value_t closedResult(int num_state_rows, int num_state_cols);
+
+
+#endif
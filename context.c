@@ -0,0 +1,451 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+
+#include "wavefront.h"
+#include "tiled.h"
+#include "groups.h"
+#include "recursive.h"
+#include "simd.h"
+#include "stream.h"
+#include "closed.h"
+#include "tune.h"
+#ifdef WF_GPU
+#include "gpu.h"
+#endif
+#include "report.h"
+#include "value.h"
+#include "stencil.h"
+#include "state_array.h"
+#include "cache.h"
+#include "grid_file.h"
+#include "futex.h"
+
+/** This file implements the persistent wavefront service declared in wavefront.h. The
+ *  thread-per-cell engines create their threads per query by design, and the simd and
+ *  stream engines have no threads to keep, so the context only holds on to the tiled
+ *  engine. Its pool is started by the first query that runs on it, with a state array of
+ *  at least the size given at creation, and stays up until the context is destroyed. With
+ *  more than one group, tiled queries run on a set of groups instead (see groups.h), each
+ *  with its own engine and state array.
+ *
+ *  The engines that use a state array share the context's through acquireStateArray(),
+ *  so it is allocated (and, in the mutex build, its mutexes initialized) once for the
+ *  largest query rather than once per query.
+ *
+ *  With the cache option, wavefrontRun() first looks the shape up in the result cache, and
+ *  on a hit reports every round from it without running an engine.
+ *
+ *  With the grid_file option, a row-major query runs on a state array whose sum plane is
+ *  the mapped file, in place of the context's array, so the engine writes its sums straight
+ *  into the file.
+ */
+
+
+
+_Static_assert(WAVEFRONT_MAX_ROUNDS < BORDER_EPOCH && BORDER_EPOCH < EPOCH_WAITERS,
+               "a round's epoch must stay below the border epoch");
+
+// Non-zero while a context exists. The result cache and the output of reportRound() are
+// kept per process, so a second context would share (and close) them.
+static atomic_int context_open = 0;
+
+
+struct wavefront_context{
+
+    engine_opts opts;
+    int max_rows, max_cols;
+    tiled_engine *tiled;    // the tiled engine (NULL until needed)
+    wf_groups *groups;      // the tiled engine groups, with opts.groups > 1 (NULL until needed)
+    state_array_t *sa;      // the state array, kept between queries (NULL until needed)
+};
+
+
+
+wavefront_context * wavefrontContextCreate(int max_rows, int max_cols, const engine_opts *opts){
+
+    // Only the tiled engine runs groups; the auto engine keeps to it when there are some.
+    if(opts->groups > 1 && opts->engine != ENGINE_TILED && opts->engine != ENGINE_AUTO){
+        fprintf(stderr, "wavefrontContextCreate: groups need the tiled engine, not %s\n",
+                engineName(opts->engine));
+        return NULL;
+    }
+
+    if(atomic_exchange(&context_open, 1) != 0){
+        fprintf(stderr, "wavefrontContextCreate: another context is still open\n");
+        return NULL;
+    }
+
+    wavefront_context *ctx = malloc(sizeof(wavefront_context));
+    if(ctx == NULL){
+        atomic_store(&context_open, 0);
+        return NULL;
+    }
+
+    ctx->opts = *opts;
+    ctx->max_rows = max_rows;
+    ctx->max_cols = max_cols;
+    ctx->tiled = NULL;
+    ctx->groups = NULL;
+    ctx->sa = NULL;
+
+    if(opts->cache && cacheOpen(opts->cache_file) != 0){
+
+        fprintf(stderr, "Keeping the result cache in memory instead\n");
+        if(cacheOpen(NULL) != 0){
+            ctx->opts.cache = 0;
+        }
+    }
+
+    return ctx;
+}
+
+
+/** Return non-zero if the engine leaves the final sum of every element in the state array.*/
+static int fillsStateArray(engine_kind engine){
+
+    return engine == ENGINE_CELL || engine == ENGINE_PIPELINE || engine == ENGINE_TILED
+        || engine == ENGINE_RECURSIVE;
+}
+
+
+/** Set the engine of a query in ctx->opts, which the caller restores afterwards. With the
+ *  auto engine, the tuner also sets the thread count and tile size (see tune.h). A query
+ *  that needs the sum of every element runs on the tiled engine if the one selected
+ *  doesn't fill in the state array.
+ */
+static void chooseEngine(wavefront_context *ctx, int num_state_rows, int num_state_cols,
+                         int numRounds, int full){
+
+    if(ctx->opts.engine != ENGINE_AUTO){
+
+        if(full && !fillsStateArray(ctx->opts.engine)){
+            ctx->opts.engine = ENGINE_TILED;
+        }
+        return;
+    }
+
+    // Groups are made of tiled workers, so the tuner has nothing to choose.
+    if(ctx->opts.groups > 1){
+
+        if(ctx->opts.explain){
+            fprintf(stderr, "auto: %d groups, so tiled\n", ctx->opts.groups);
+        }
+        ctx->opts.engine = ENGINE_TILED;
+        return;
+    }
+
+    tune_choice choice;
+    tuneChoose(num_state_rows, num_state_cols, numRounds, full, &ctx->opts, &choice);
+
+    if(ctx->opts.explain){
+
+        tuneExplain(stderr, num_state_rows, num_state_cols, numRounds, &choice);
+        if(choice.engine == ENGINE_TILED && (ctx->tiled != NULL || ctx->groups != NULL)){
+            fprintf(stderr, "auto: the context's tiled workers are already running, "
+                            "and keep their threads and tiles\n");
+        }
+    }
+
+    ctx->opts.engine = choice.engine;
+    ctx->opts.num_threads = choice.num_threads;
+    ctx->opts.tile_rows = choice.tile_rows;
+    ctx->opts.tile_cols = choice.tile_cols;
+}
+
+
+/** Start the context's tiled engine, if it isn't running yet.
+ *  @return 0 on success, or -1 on failure
+ */
+static int startTiled(wavefront_context *ctx, int num_state_rows, int num_state_cols){
+
+    if(ctx->tiled != NULL){
+        return 0;
+    }
+
+    int rows = num_state_rows > ctx->max_rows ? num_state_rows : ctx->max_rows;
+    int cols = num_state_cols > ctx->max_cols ? num_state_cols : ctx->max_cols;
+
+    // Allocate for the largest expected query up front, so that later queries only
+    // reshape the array.
+    ctx->sa = acquireStateArray(ctx->sa, rows, cols, ctx->opts.affinity);
+    if(ctx->sa == NULL){
+        return -1;
+    }
+    ctx->tiled = tiledCreate(rows, cols, &ctx->opts, 0, 0);
+
+    return ctx->tiled != NULL ? 0 : -1;
+}
+
+
+/** Run a query whose final sums go to the grid file, on an engine that fills in the state
+ *  array.
+ *  @return 0 on success, or an error code
+ */
+static int runToGridFile(wavefront_context *ctx, int num_state_rows, int num_state_cols,
+                         int numRounds, value_t *result){
+
+    grid_file gf;
+    if(gridFileCreate(&gf, ctx->opts.grid_file, num_state_rows, num_state_cols,
+                      ctx->opts.layout) != 0){
+        return EXIT_FAILURE;
+    }
+
+    engine_opts opts = ctx->opts;
+    chooseEngine(ctx, num_state_rows, num_state_cols, numRounds, 1);
+    engine_kind engine = ctx->opts.engine;
+    ctx->opts.cache = 0;
+    ctx->opts.groups = 1;
+    ctx->opts.grid_file = NULL;
+
+    // The tiled engine replaces a state array that is smaller than its maximum, so it is
+    // started first, and then only reshapes the one over the file.
+    int status = EXIT_SUCCESS;
+    if(engine == ENGINE_TILED && startTiled(ctx, num_state_rows, num_state_cols) != 0){
+        status = EXIT_FAILURE;
+    }
+
+    state_array_t *kept = ctx->sa;
+    state_array_t *over = NULL;
+
+    if(status == EXIT_SUCCESS && opts.layout == GRID_ROW_MAJOR){
+
+        over = createStateArrayOver(num_state_rows, num_state_cols, gf.values);
+        if(over == NULL){
+            status = EXIT_FAILURE;
+        } else {
+            ctx->sa = over;
+        }
+    }
+
+    if(status == EXIT_SUCCESS){
+        status = wavefrontRun(ctx, num_state_rows, num_state_cols, numRounds, result);
+    }
+
+    if(status == EXIT_SUCCESS && opts.layout == GRID_DIAGONAL_MAJOR){
+        gridFileStoreDiagonals(&gf, getSumPlane(ctx->sa), num_state_rows, num_state_cols,
+                               getRowStride(ctx->sa));
+    }
+
+    if(over != NULL){
+        destroyStateArray(over);
+        ctx->sa = kept;
+    }
+    ctx->opts = opts;
+    gridFileClose(&gf);
+
+    return status;
+}
+
+
+int wavefrontRun(wavefront_context *ctx, int num_state_rows, int num_state_cols, int numRounds,
+                 value_t *result){
+
+    int status;
+    value_t cached;
+
+    if(num_state_rows < 1 || num_state_cols < 1 || numRounds < 0
+       || numRounds > WAVEFRONT_MAX_ROUNDS){
+        fprintf(stderr, "Bad query: %d x %d, %d rounds\n", num_state_rows, num_state_cols,
+                numRounds);
+        return EXIT_FAILURE;
+    }
+
+    if(!gridAccepts(num_state_rows, num_state_cols)){
+        fprintf(stderr, "This build only runs %d x %d grids (see grid.h)\n",
+                gridRows(gridMake(num_state_rows, num_state_cols)),
+                gridCols(gridMake(num_state_rows, num_state_cols)));
+        return EXIT_FAILURE;
+    }
+
+    if(ctx->opts.grid_file != NULL){
+        return runToGridFile(ctx, num_state_rows, num_state_cols, numRounds, result);
+    }
+
+    if(ctx->opts.cache && numRounds > 0 && cacheLookup(num_state_rows, num_state_cols, &cached)){
+
+        for(int round=0; round < numRounds; round++){
+            reportCachedRound(round, cached);
+        }
+        if(result != NULL){
+            *result = cached;
+        }
+        return reportFlush() == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    engine_opts opts = ctx->opts;
+    chooseEngine(ctx, num_state_rows, num_state_cols, numRounds, 0);
+
+    switch(ctx->opts.engine){
+
+        case ENGINE_TILED:
+            if(ctx->opts.groups > 1){
+
+                if(ctx->groups == NULL){
+                    int rows = num_state_rows > ctx->max_rows ? num_state_rows : ctx->max_rows;
+                    int cols = num_state_cols > ctx->max_cols ? num_state_cols : ctx->max_cols;
+
+                    ctx->groups = groupsCreate(ctx->opts.groups, rows, cols, &ctx->opts);
+                    if(ctx->groups == NULL){
+                        status = EXIT_FAILURE;
+                        break;
+                    }
+                }
+                status = groupsRun(ctx->groups, num_state_rows, num_state_cols, numRounds);
+                break;
+            }
+
+            if(startTiled(ctx, num_state_rows, num_state_cols) != 0){
+                status = EXIT_FAILURE;
+                break;
+            }
+            status = tiledRun(ctx->tiled, &ctx->sa, num_state_rows, num_state_cols, numRounds,
+                              NULL, NULL);
+            break;
+
+        case ENGINE_RECURSIVE:
+            status = recursiveWavefront(&ctx->sa, num_state_rows, num_state_cols, numRounds,
+                                        &ctx->opts);
+            break;
+
+        case ENGINE_SIMD:
+            status = simdWavefront(num_state_rows, num_state_cols, numRounds, &ctx->opts);
+            break;
+
+        case ENGINE_STREAM:
+            status = streamWavefront(num_state_rows, num_state_cols, numRounds, &ctx->opts);
+            break;
+
+        case ENGINE_CLOSED:
+            status = closedWavefront(num_state_rows, num_state_cols, numRounds, &ctx->opts);
+            break;
+
+#ifdef WF_GPU
+        case ENGINE_GPU:
+            status = gpuWavefront(num_state_rows, num_state_cols, numRounds);
+            break;
+#endif
+
+        default:
+            status = cellWavefront(&ctx->sa, num_state_rows, num_state_cols, numRounds, &ctx->opts);
+            break;
+    }
+
+    ctx->opts = opts;
+
+    if(ctx->opts.cache && numRounds > 0 && status == EXIT_SUCCESS){
+        cacheStore(num_state_rows, num_state_cols, reportLastResult());
+    }
+
+    if(result != NULL){
+        *result = reportLastResult();
+    }
+
+    if(reportFlush() != 0){
+        status = EXIT_FAILURE;
+    }
+
+    return status;
+}
+
+
+int wavefrontBatch(wavefront_context *ctx, const int *rows, const int *cols, int n,
+                   value_t *results){
+
+    // Queries found in the cache, or answered by the closed form, don't count toward the
+    // shape of the sweep.
+    int max_rows = 0, max_cols = 0;
+    for(int q=0; q < n; q++){
+
+        if(rows[q] < 1 || cols[q] < 1){
+            return EXIT_FAILURE;
+        }
+        if(ctx->opts.cache && cacheLookup(rows[q], cols[q], &results[q])){
+            continue;
+        }
+
+#ifdef STENCIL_DELANNOY
+        // The closed form answers a query faster than a sweep could.
+        if(ctx->opts.engine == ENGINE_CLOSED){
+
+            results[q] = closedResult(rows[q], cols[q]);
+            if(ctx->opts.cache){
+                cacheStore(rows[q], cols[q], results[q]);
+            }
+            continue;
+        }
+#endif
+        if(rows[q] > max_rows) max_rows = rows[q];
+        if(cols[q] > max_cols) max_cols = cols[q];
+    }
+
+    if(max_rows == 0){
+        return EXIT_SUCCESS;
+    }
+
+    // Only the engines that fill in the state array leave every sub-grid's answer behind.
+    engine_opts opts = ctx->opts;
+    ctx->opts.cache = 0;
+    ctx->opts.groups = 1;       // the groups' arrays aren't the context's
+    ctx->opts.grid_file = NULL;
+    chooseEngine(ctx, max_rows, max_cols, 1, 1);
+
+    // The sweep's own result isn't an answer to anything, so it is recorded, not printed.
+    value_t sweep_value;
+    double sweep_time;
+    reportRecord(&sweep_value, &sweep_time, 1);
+
+    int status = wavefrontRun(ctx, max_rows, max_cols, 1, NULL);
+
+    reportPrint();
+    ctx->opts = opts;
+
+    if(status != EXIT_SUCCESS){
+        return status;
+    }
+
+    // Element (i, j) is the north-west corner of the sub-grid of (R - i) x (C - j) elements
+    // rooted at the south-east corner, which is all that its sum depends on.
+    const value_t *sum = getSumPlane(ctx->sa);
+    grid_t g = getGrid(ctx->sa);
+    for(int q=0; q < n; q++){
+
+        if(rows[q] <= max_rows && cols[q] <= max_cols){
+
+            results[q] = sum[gridIndex(g, max_rows - rows[q], max_cols - cols[q])];
+            if(opts.cache){
+                cacheStore(rows[q], cols[q], results[q]);
+            }
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
+
+
+int wavefrontContextDestroy(wavefront_context *ctx){
+
+    int status = EXIT_SUCCESS;
+
+    if(ctx->tiled != NULL){
+        status = tiledDestroy(ctx->tiled);
+    }
+    if(ctx->groups != NULL && groupsDestroy(ctx->groups) != EXIT_SUCCESS){
+        status = EXIT_FAILURE;
+    }
+    if(ctx->opts.stats && ctx->sa != NULL){
+        describeStateArray(ctx->sa, stderr);
+    }
+    destroyStateArray(ctx->sa);
+
+    if(ctx->opts.cache){
+        cacheClose();
+    }
+
+    free(ctx);
+    atomic_store(&context_open, 0);
+
+    return status;
+}
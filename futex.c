@@ -0,0 +1,69 @@
+// syscall() is a GNU/BSD extension, so this file doesn't include state_array.h (see the
+// note on index() there).
+#define _GNU_SOURCE
+
+#include <limits.h>
+#include <sched.h>
+#include <stdatomic.h>
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
+
+#include "futex.h"
+
+
+void futexWait(atomic_int *addr, int expected){
+
+#ifdef __linux__
+    syscall(SYS_futex, (int *) addr, FUTEX_WAIT_PRIVATE, expected, NULL, NULL, 0);
+#else
+    if(atomic_load_explicit(addr, memory_order_relaxed) == expected){
+        sched_yield();
+    }
+#endif
+}
+
+
+void futexWakeAll(atomic_int *addr){
+
+#ifdef __linux__
+    syscall(SYS_futex, (int *) addr, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+#else
+    (void) addr;
+#endif
+}
+
+
+void epochWait(atomic_int *word, int target){
+
+    int seen = atomic_load_explicit(word, memory_order_acquire);
+
+    for(int spin=0; (seen & ~EPOCH_WAITERS) < target && spin < SPIN_LIMIT; spin++){
+        cpuRelax();
+        seen = atomic_load_explicit(word, memory_order_acquire);
+    }
+
+    while((seen & ~EPOCH_WAITERS) < target){
+
+        if((seen & EPOCH_WAITERS) == 0 &&
+           !atomic_compare_exchange_weak_explicit(word, &seen, seen | EPOCH_WAITERS,
+                                                  memory_order_acquire, memory_order_acquire)){
+            continue;   // the word changed under us; seen holds the new value
+        }
+
+        futexWait(word, seen | EPOCH_WAITERS);
+        seen = atomic_load_explicit(word, memory_order_acquire);
+    }
+}
+
+
+void epochPublish(atomic_int *word, int value){
+
+    int old = atomic_exchange_explicit(word, value, memory_order_release);
+    if(old & EPOCH_WAITERS){
+        futexWakeAll(word);
+    }
+}
@@ -0,0 +1,67 @@
+#ifndef FUTEX_H
+#define FUTEX_H
+
+/*
+ * futex.h
+ *
+ * Sleeping and waking on a 32-bit atomic word. On Linux these are thin wrappers around
+ * the futex system call; elsewhere the wait falls back to yielding the processor.
+ *
+ * On top of those, epochWait() and epochPublish() implement a wait on a counter that only
+ * grows: waiters spin for a while, then set the EPOCH_WAITERS bit in the word and sleep on
+ * it, so the publisher only makes the wake-up system call when somebody is asleep.
+ * Counter values must stay below EPOCH_WAITERS.
+ */
+#include <stdatomic.h>
+
+// Number of times a waiter re-reads a word before it goes to sleep on it.
+#define SPIN_LIMIT 128
+
+// Set in an epoch word by a waiter that is about to sleep on it.
+#define EPOCH_WAITERS 0x40000000
+
+
+/** Give the core a hint that the calling thread is spinning.*/
+static inline void cpuRelax(){
+
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+/** Sleep until the word at addr is woken, unless it no longer holds the expected value.
+ *  Like any futex wait, this may return spuriously; the caller must re-check its condition.
+ *
+ *  @param addr the word to wait on
+ *  @param expected the value the caller last saw in the word
+ */
+void futexWait(atomic_int *addr, int expected);
+
+/** Wake every thread sleeping on the word at addr.*/
+void futexWakeAll(atomic_int *addr);
+
+/** Wait until the epoch word holds at least the target value. The load that sees it has
+ *  acquire ordering.
+ *
+ *  @param word the epoch word
+ *  @param target the value to wait for
+ */
+void epochWait(atomic_int *word, int target);
+
+/** Store a new value in the epoch word with release ordering, and wake any waiters.
+ *
+ *  @param word the epoch word
+ *  @param value the new value
+ */
+void epochPublish(atomic_int *word, int value);
+
+/** Return the value of an epoch word, without the waiters bit.*/
+static inline int epochRead(atomic_int *word, memory_order order){
+
+    return atomic_load_explicit(word, order) & ~EPOCH_WAITERS;
+}
+
+
+#endif
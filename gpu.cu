@@ -0,0 +1,117 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <cuda_runtime.h>
+
+extern "C" {
+#include "value.h"
+#include "stencil.h"
+#include "report.h"
+}
+#include "gpu.h"
+
+/** The kernel uses the coordinates of simd.c: r and c are measured from the south-east
+ *  corner, diagonal k holds the elements with r + c == k, indexed by r, and an interior
+ *  element is
+ *
+ *      D[k][r] = D[k-1][r-1] + D[k-1][r] + D[k-2][r-1]
+ *
+ *  (or the stencil selected in stencil.h, which is compiled for the device too). Consecutive threads handle consecutive r, so every load and store of a launch is
+ *  coalesced. A launch depends on the previous two through device memory only; launches
+ *  on one stream run in order, so no other synchronization is needed until element 0 is
+ *  copied back.
+ */
+
+
+
+#define GPU_BLOCK_SIZE 256
+
+
+/** Compute diagonal k, elements lo through hi, including its border elements.*/
+__global__ static void diagonalKernel(value_t *cur, const value_t *prev, const value_t *prev2,
+                                      int k, int lo, int hi){
+
+    int r = lo + blockIdx.x * blockDim.x + threadIdx.x;
+    if(r > hi){
+        return;
+    }
+
+    // Border elements: r == 0 (the bottom row) and c == 0 (the last column).
+    if(r == 0){
+        cur[r] = stencilBorder(0, k);
+    } else if(r == k){
+        cur[r] = stencilBorder(k, 0);
+    } else {
+        cur[r] = stencilCombine(prev[r], prev[r - 1], prev2[r - 1], r, k - r);
+    }
+}
+
+
+/** Print a CUDA error, if there was one.
+ *  @return non-zero if err is an error
+ */
+static int gpuFailed(cudaError_t err, const char *what){
+
+    if(err != cudaSuccess){
+        fprintf(stderr, "gpu: %s: %s\n", what, cudaGetErrorString(err));
+        return 1;
+    }
+
+    return 0;
+}
+
+
+extern "C" int gpuWavefront(int num_state_rows, int num_state_cols, int numRounds){
+
+    int R = num_state_rows;
+    int C = num_state_cols;
+
+    value_t *diags = NULL;
+    if(gpuFailed(cudaMalloc((void **) &diags, 3 * (size_t) R * sizeof(value_t)), "cudaMalloc")){
+        return EXIT_FAILURE;
+    }
+
+    int status = EXIT_SUCCESS;
+
+    for(int round=0; round < numRounds && status == EXIT_SUCCESS; round++){
+
+        value_t *cur = diags;
+        value_t *prev = diags + R;
+        value_t *prev2 = diags + 2 * (size_t) R;
+
+        for(int k=0; k <= R + C - 2; k++){
+
+            // Diagonal k has the elements with c = k - r in 0 .. C-1.
+            int lo = (k - (C - 1) > 0) ? k - (C - 1) : 0;
+            int hi = (k < R - 1) ? k : R - 1;
+            int n = hi - lo + 1;
+
+            diagonalKernel<<<(n + GPU_BLOCK_SIZE - 1) / GPU_BLOCK_SIZE, GPU_BLOCK_SIZE>>>(
+                cur, prev, prev2, k, lo, hi);
+
+            value_t *t = prev2;
+            prev2 = prev;
+            prev = cur;
+            cur = t;
+        }
+
+        if(gpuFailed(cudaGetLastError(), "kernel launch")){
+            status = EXIT_FAILURE;
+            break;
+        }
+
+        // The last diagonal computed (now in prev) holds only element 0. The copy waits
+        // for the round's kernels to finish.
+        value_t result;
+        if(gpuFailed(cudaMemcpy(&result, prev + R - 1, sizeof(value_t), cudaMemcpyDeviceToHost),
+                     "cudaMemcpy")){
+            status = EXIT_FAILURE;
+            break;
+        }
+
+        reportRound(round, result);
+    }
+
+    cudaFree(diags);
+
+    return status;
+}
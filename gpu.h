@@ -0,0 +1,37 @@
+#ifndef GPU_H
+#define GPU_H
+
+#include "value.h"
+
+/*
+ * gpu.h
+ *
+ * The GPU engine, built with "make GPU=1" (which defines WF_GPU and compiles gpu.cu with
+ * nvcc). Without it, there is no "gpu" engine.
+ *
+ * The engine runs the anti-diagonal sweep of the simd engine (see simd.h) on a CUDA
+ * device: the three diagonals stay resident in device memory across all rounds, each
+ * diagonal is computed by one kernel launch with one thread per element, and only element
+ * 0 is copied back at the end of a round.
+ *
+ * This header is included from both C and CUDA C++, so it only uses plain types.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/** Run the wavefront computation on the GPU, printing the result of each round. The
+ *  engine options have nothing to select for it. See wavefront() for the parameters.
+ *
+ *  @return 0 on success, or an error code if there is no device or a CUDA call failed
+ */
+int gpuWavefront(int num_state_rows, int num_state_cols, int numRounds);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,101 @@
+#ifndef GRID_H
+#define GRID_H
+
+/*
+ * grid.h
+ *
+ * Index math for a row-major grid of nrows x ncols elements, as static inline functions of
+ * a grid_t handle passed by value. Callers copy the handle into a local once, so hot loops
+ * compute neighbor indices from a register instead of re-reading a shared global through
+ * a function call.
+ *
+ * Building with -DGRID_ROWS=R and/or -DGRID_COLS=C ("make GRID=RxC") fixes the shape at
+ * compile time: gridRows() and gridCols() then return the constants, so the row stride
+ * and loop bounds of the tiled and simd kernels are known to the compiler, which can
+ * fully unroll and vectorize them. Such a build only accepts grids of that shape (see
+ * gridAccepts()).
+ *
+ * A row of a grid may take up more than ncols elements: element (r, c) is at index
+ * r * stride + c, and the elements past ncols pad each row out (see allocRowStride() in
+ * alloc.h). With GRID_COLS, rows aren't padded, so the stride is a constant too.
+ */
+
+
+typedef struct{
+
+    int nrows;
+    int ncols;
+    int stride;     // elements per row, at least ncols
+} grid_t;
+
+
+/** Return a handle for a grid of the given shape, with unpadded rows.*/
+static inline grid_t gridMake(int nrows, int ncols){
+
+    grid_t g = { nrows, ncols, ncols };
+    return g;
+}
+
+/** Return a handle for a grid of the given shape whose rows are stride elements apart.*/
+static inline grid_t gridMakeStrided(int nrows, int ncols, int stride){
+
+    grid_t g = { nrows, ncols, stride };
+    return g;
+}
+
+/** Return the number of rows in a grid.*/
+static inline int gridRows(grid_t g){
+
+#ifdef GRID_ROWS
+    (void) g;
+    return GRID_ROWS;
+#else
+    return g.nrows;
+#endif
+}
+
+/** Return the number of columns in a grid.*/
+static inline int gridCols(grid_t g){
+
+#ifdef GRID_COLS
+    (void) g;
+    return GRID_COLS;
+#else
+    return g.ncols;
+#endif
+}
+
+/** Return the distance between the starts of two rows, in elements.*/
+static inline int gridStride(grid_t g){
+
+#ifdef GRID_COLS
+    (void) g;
+    return GRID_COLS;
+#else
+    return g.stride;
+#endif
+}
+
+/** Return non-zero if this build can run a grid of the given shape.*/
+static inline int gridAccepts(int nrows, int ncols){
+
+    grid_t g = gridMake(nrows, ncols);
+    return gridRows(g) == nrows && gridCols(g) == ncols;
+}
+
+/** Given a row and column, return the index of the element.*/
+static inline int gridIndex(grid_t g, int r, int c){
+
+    return r * gridStride(g) + c;
+}
+
+/** Given the index of an element, return the index of a neighbor.*/
+static inline int gridN(grid_t g, int i){ return i - gridStride(g); }
+static inline int gridS(grid_t g, int i){ return i + gridStride(g); }
+static inline int gridE(grid_t g, int i){ (void) g; return i + 1; }
+static inline int gridW(grid_t g, int i){ (void) g; return i - 1; }
+static inline int gridSE(grid_t g, int i){ return i + gridStride(g) + 1; }
+static inline int gridNW(grid_t g, int i){ return i - gridStride(g) - 1; }
+
+
+#endif
@@ -0,0 +1,97 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "grid_file.h"
+#include "value.h"
+#include "stencil.h"
+
+
+_Static_assert(sizeof(grid_file_header) <= GRID_FILE_HEADER_SIZE, "grid file header too large");
+
+
+
+int gridFileCreate(grid_file *gf, const char *path, int rows, int cols, grid_layout layout){
+
+    size_t size = GRID_FILE_HEADER_SIZE + (size_t) rows * cols * sizeof(value_t);
+
+    // Truncating to 0 first drops the old contents, so the values read as zeros.
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0){
+        perror(path);
+        return -1;
+    }
+
+    if(ftruncate(fd, (off_t) size) != 0){
+        perror(path);
+        close(fd);
+        return -1;
+    }
+
+    void *p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(p == MAP_FAILED){
+        perror(path);
+        return -1;
+    }
+
+    grid_file_header *h = p;
+    memcpy(h->magic, GRID_FILE_MAGIC, sizeof(GRID_FILE_MAGIC));
+    h->header_size = GRID_FILE_HEADER_SIZE;
+    h->value_size = sizeof(value_t);
+    h->rows = rows;
+    h->cols = cols;
+    h->layout = (uint32_t) layout;
+    h->reserved = 0;
+    snprintf(h->value_type, sizeof(h->value_type), "%s", valueTypeName());
+    snprintf(h->stencil, sizeof(h->stencil), "%s", STENCIL_NAME);
+
+    gf->base = p;
+    gf->size = size;
+    gf->values = (value_t *)((char *) p + GRID_FILE_HEADER_SIZE);
+
+    return 0;
+}
+
+
+void gridFileStoreDiagonals(grid_file *gf, const value_t *sums, int rows, int cols, int stride){
+
+    value_t *out = gf->values;
+
+    for(int d=0; d <= rows + cols - 2; d++){
+
+        int lo = (d - (cols - 1) > 0) ? d - (cols - 1) : 0;
+        int hi = (d < rows - 1) ? d : rows - 1;
+
+        for(int r=lo; r <= hi; r++){
+            *out++ = sums[(size_t) r * stride + (d - r)];
+        }
+    }
+}
+
+
+void gridFileClose(grid_file *gf){
+
+    munmap(gf->base, gf->size);
+    gf->base = NULL;
+    gf->values = NULL;
+}
+
+
+int gridLayoutFromName(const char *name, grid_layout *layout){
+
+    if(strcmp(name, "rows") == 0){
+        *layout = GRID_ROW_MAJOR;
+    } else if(strcmp(name, "diagonals") == 0){
+        *layout = GRID_DIAGONAL_MAJOR;
+    } else {
+        return -1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,91 @@
+#ifndef GRID_FILE_H
+#define GRID_FILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "value.h"
+
+/*
+ * grid_file.h
+ *
+ * A binary file holding the final sum of every element of a state array, for programs
+ * that need the whole grid and not just element 0. The file is a grid_file_header
+ * followed, at offset header_size, by rows * cols values of value_size bytes each, in the
+ * writer's byte order:
+ *
+ *      GRID_ROW_MAJOR          element (r, c) is value r * cols + c, as in the state array
+ *      GRID_DIAGONAL_MAJOR     the anti-diagonals d = r + c = 0, 1, ..., rows + cols - 2 one
+ *                              after the other, each in order of increasing r
+ *
+ * Readers can map the file and use the values in place. The file is written through a
+ * shared mapping; in row-major order the engine computes straight into it (see
+ * createStateArrayOver()), so there is no copy at all.
+ */
+
+// The magic string at the start of a grid file.
+#define GRID_FILE_MAGIC "WFGRID1"
+
+// The offset of the first value. It keeps the values aligned to a cache line.
+#define GRID_FILE_HEADER_SIZE 128
+
+typedef enum{
+
+    GRID_ROW_MAJOR,
+    GRID_DIAGONAL_MAJOR
+} grid_layout;
+
+typedef struct{
+
+    char magic[8];          // GRID_FILE_MAGIC, with its terminator
+    uint32_t header_size;   // GRID_FILE_HEADER_SIZE
+    uint32_t value_size;    // sizeof(value_t)
+    int64_t rows;
+    int64_t cols;
+    uint32_t layout;        // a grid_layout
+    uint32_t reserved;
+    char value_type[32];    // valueTypeName(), with its terminator
+    char stencil[16];       // STENCIL_NAME (see stencil.h), with its terminator
+} grid_file_header;
+
+// A grid file mapped for writing.
+typedef struct{
+
+    void *base;             // the mapping, starting with the header
+    size_t size;            // the size of the mapping
+    value_t *values;        // the first value, base + GRID_FILE_HEADER_SIZE
+} grid_file;
+
+
+/** Create (or truncate) a grid file for an array of the given shape, write its header, and
+ *  map it. The values start out as zeros.
+ *
+ *  @param gf set to the mapped file
+ *  @param path the file to create
+ *  @param rows number of rows in the state array
+ *  @param cols number of columns in the state array
+ *  @param layout the order of the values
+ *  @return 0 on success, or -1 on failure
+ */
+int gridFileCreate(grid_file *gf, const char *path, int rows, int cols, grid_layout layout);
+
+/** Write the sums of a row-major state array to a grid file in diagonal-major order.
+ *
+ *  @param gf the grid file
+ *  @param sums the sum plane of the state array
+ *  @param rows number of rows in the state array
+ *  @param cols number of columns in the state array
+ *  @param stride number of elements per row of sums, including padding
+ */
+void gridFileStoreDiagonals(grid_file *gf, const value_t *sums, int rows, int cols, int stride);
+
+/** Unmap a grid file. Its contents stay in the file.*/
+void gridFileClose(grid_file *gf);
+
+/** Look up a layout by name ("rows" or "diagonals").
+ *  @return 0 on success, or -1 if there is no such layout
+ */
+int gridLayoutFromName(const char *name, grid_layout *layout);
+
+
+#endif
@@ -0,0 +1,242 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "groups.h"
+#include "tiled.h"
+#include "state_array.h"
+#include "futex.h"
+#include "report.h"
+#include "affinity.h"
+
+/** Each group is driven by a thread of its own, which runs the group's share of the rounds
+ *  on its engine. The driver stores the result of each round in a shared array and
+ *  publishes a per-round ready flag, and the calling thread waits for the flags in round
+ *  order to print the results. With the affinity option, the driver is pinned with the
+ *  first worker of its group, so the group's state array is first touched on its node.
+ */
+
+
+
+struct wf_groups{
+
+    int num_groups;
+    int threads_per_group;
+    int affinity;
+    int stats;
+    tiled_engine **engines;
+    state_array_t **arrays;
+};
+
+
+// One run across the groups: the shared results, and what each driver needs.
+typedef struct{
+
+    wf_groups *grp;
+    int rows, cols, numRounds;
+    value_t *results;
+    atomic_int *ready;      // ready[r] is 1 once results[r] is stored, or 2 if it failed
+} groups_job;
+
+typedef struct{
+
+    groups_job *job;
+    int group;
+    int status;             // the driver's own status, collected once it is joined
+    pthread_t thread;
+} group_driver;
+
+
+
+wf_groups * groupsCreate(int num_groups, int max_state_rows, int max_state_cols,
+                         const engine_opts *opts){
+
+    wf_groups *grp = malloc(sizeof(wf_groups));
+    if(grp == NULL){
+        return NULL;
+    }
+
+    int total = opts->num_threads;
+    if(total <= 0){
+        total = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    }
+
+    grp->num_groups = num_groups > 0 ? num_groups : 1;
+    grp->threads_per_group = total / grp->num_groups > 0 ? total / grp->num_groups : 1;
+    grp->affinity = opts->affinity;
+    grp->stats = opts->stats;
+    grp->engines = calloc(grp->num_groups, sizeof(tiled_engine *));
+    grp->arrays = calloc(grp->num_groups, sizeof(state_array_t *));
+    if(grp->engines == NULL || grp->arrays == NULL){
+        groupsDestroy(grp);
+        return NULL;
+    }
+
+    engine_opts group_opts = *opts;
+    group_opts.num_threads = grp->threads_per_group;
+
+    int num_slots = grp->num_groups * grp->threads_per_group;
+    if(opts->affinity){
+        affinityReport(stderr, num_slots, max_state_rows);
+    }
+
+    for(int g=0; g < grp->num_groups; g++){
+
+        grp->engines[g] = tiledCreate(max_state_rows, max_state_cols, &group_opts,
+                                      g * grp->threads_per_group, num_slots);
+        if(grp->engines[g] == NULL){
+            // Stops and frees the groups created so far.
+            groupsDestroy(grp);
+            return NULL;
+        }
+    }
+
+    return grp;
+}
+
+
+/** Mark the rounds of group g that haven't been stored as failed, so the printer doesn't
+ *  wait on them.
+ */
+static void failRounds(groups_job *job, int g){
+
+    for(int r=g; r < job->numRounds; r += job->grp->num_groups){
+        if(epochRead(&job->ready[r], memory_order_acquire) == 0){
+            epochPublish(&job->ready[r], 2);
+        }
+    }
+}
+
+
+/** The round function of a group: store the result of its local round i, which is round
+ *  group + i * K overall.
+ */
+static void storeResult(void *ctx, int round, value_t result){
+
+    group_driver *d = (group_driver *) ctx;
+    groups_job *job = d->job;
+
+    int r = d->group + round * job->grp->num_groups;
+
+    job->results[r] = result;
+    epochPublish(&job->ready[r], 1);
+}
+
+
+static void * groupDriver(void *a){
+
+    group_driver *d = (group_driver *) a;
+    groups_job *job = d->job;
+    wf_groups *grp = job->grp;
+    int K = grp->num_groups;
+
+    if(grp->affinity){
+        affinityPin(affinityCpu(d->group * grp->threads_per_group, K * grp->threads_per_group));
+    }
+
+    int rounds = (job->numRounds - d->group + K - 1) / K;
+    if(rounds > 0 &&
+       tiledRun(grp->engines[d->group], &grp->arrays[d->group], job->rows, job->cols,
+                rounds, storeResult, d) != 0){
+
+        d->status = EXIT_FAILURE;
+        failRounds(job, d->group);
+    }
+
+    return NULL;
+}
+
+
+int groupsRun(wf_groups *grp, int num_state_rows, int num_state_cols, int numRounds){
+
+    groups_job job;
+    job.grp = grp;
+    job.rows = num_state_rows;
+    job.cols = num_state_cols;
+    job.numRounds = numRounds;
+    job.results = malloc((numRounds > 0 ? numRounds : 1) * sizeof(value_t));
+    job.ready = malloc((numRounds > 0 ? numRounds : 1) * sizeof(atomic_int));
+    group_driver *drivers = malloc(grp->num_groups * sizeof(group_driver));
+
+    if(job.results == NULL || job.ready == NULL || drivers == NULL){
+        free(job.results);
+        free(job.ready);
+        free(drivers);
+        return EXIT_FAILURE;
+    }
+
+    for(int r=0; r < numRounds; r++){
+        atomic_init(&job.ready[r], 0);
+    }
+
+    int status = EXIT_SUCCESS;
+    int started = 0;
+
+    for(; started < grp->num_groups; started++){
+
+        drivers[started].job = &job;
+        drivers[started].group = started;
+        drivers[started].status = EXIT_SUCCESS;
+
+        if(pthread_create(&drivers[started].thread, NULL, groupDriver, &drivers[started]) != 0){
+            break;
+        }
+    }
+
+    // The groups without a driver fail their rounds, and the ones that started still run,
+    // so the printer stops at the first missing round and the drivers can be joined.
+    for(int g=started; g < grp->num_groups; g++){
+        status = EXIT_FAILURE;
+        failRounds(&job, g);
+    }
+
+    // Print the results in round order, up to the first round that failed.
+    for(int round=0; round < numRounds; round++){
+
+        epochWait(&job.ready[round], 1);
+        if(epochRead(&job.ready[round], memory_order_acquire) != 1){
+            break;
+        }
+        reportRound(round, job.results[round]);
+    }
+
+    for(int g=0; g < started; g++){
+
+        if(pthread_join(drivers[g].thread, NULL) != 0 || drivers[g].status != EXIT_SUCCESS){
+            status = EXIT_FAILURE;
+        }
+    }
+
+    free(drivers);
+    free(job.results);
+    free(job.ready);
+
+    return status;
+}
+
+
+int groupsDestroy(wf_groups *grp){
+
+    int status = EXIT_SUCCESS;
+
+    for(int g=0; grp->engines != NULL && grp->arrays != NULL && g < grp->num_groups; g++){
+
+        if(tiledDestroy(grp->engines[g]) != 0){
+            status = EXIT_FAILURE;
+        }
+        if(grp->stats && grp->arrays[g] != NULL){
+            describeStateArray(grp->arrays[g], stderr);
+        }
+        destroyStateArray(grp->arrays[g]);
+    }
+
+    free(grp->engines);
+    free(grp->arrays);
+    free(grp);
+
+    return status;
+}
@@ -0,0 +1,51 @@
+#ifndef GROUPS_H
+#define GROUPS_H
+
+#include "wavefront.h"
+
+/*
+ * groups.h
+ *
+ * Rounds run concurrently on K groups of workers. Every round computes the same result
+ * from scratch, so rounds don't depend on each other: the worker pool is split into K
+ * tiled engines (see tiled.h), each with its own state array and barrier, and group g
+ * runs rounds g, g + K, g + 2K, ... The results are printed in round order, so the output
+ * is the same as with one group.
+ *
+ * This helps when a grid is too small to keep every core busy on its own, but there are
+ * many rounds to run.
+ */
+
+typedef struct wf_groups wf_groups;
+
+
+/** Start K groups that split the worker pool between them.
+ *
+ *  @param num_groups the number of groups, K
+ *  @param max_state_rows number of rows in the largest expected state array
+ *  @param max_state_cols number of columns in the largest expected state array
+ *  @param opts the engine options. num_threads is the size of the whole pool, and each
+ *      group gets num_threads / K workers (at least one).
+ *  @return the groups, or NULL on failure
+ */
+wf_groups * groupsCreate(int num_groups, int max_state_rows, int max_state_cols,
+                         const engine_opts *opts);
+
+/** Run the rounds of a computation across the groups, printing each result in round
+ *  order with reportRound().
+ *
+ *  @param grp the groups
+ *  @param num_state_rows number of rows in the state array
+ *  @param num_state_cols number of columns in the state array
+ *  @param numRounds number of rounds to run
+ *  @return 0 on success, or an error code
+ */
+int groupsRun(wf_groups *grp, int num_state_rows, int num_state_cols, int numRounds);
+
+/** Stop the groups' workers and free their engines and state arrays.
+ *  @return 0 on success, or an error code
+ */
+int groupsDestroy(wf_groups *grp);
+
+
+#endif
@@ -0,0 +1,105 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "instrument.h"
+
+// The heatmap cells each cover a block of elements, so that it fits in a terminal.
+#define HEATMAP_MAX_ROWS 24
+#define HEATMAP_MAX_COLS 64
+
+// Shades from least to most neighbor-wait time.
+static const char SHADES[] = " .:-=+*#%@";
+
+
+
+void instrumentReport(const cell_stats *stats, int nrows, int ncols, FILE *out){
+
+    int rows = nrows - 1;
+    int cols = ncols - 1;
+
+    if(rows < 1 || cols < 1){
+        return;
+    }
+
+    uint64_t neighbor = 0, barrier = 0, compute = 0;
+    long blocked = 0;
+    int worst = 0;
+
+    for(int r=0; r < rows; r++){
+        for(int c=0; c < cols; c++){
+
+            const cell_stats *st = &stats[r * ncols + c];
+            neighbor += st->neighbor_wait_ns;
+            barrier += st->barrier_wait_ns;
+            compute += st->compute_ns;
+            blocked += st->blocked_waits;
+
+            if(st->neighbor_wait_ns > stats[worst].neighbor_wait_ns){
+                worst = r * ncols + c;
+            }
+        }
+    }
+
+    double total = (double)(neighbor + barrier + compute);
+    if(total <= 0){
+        total = 1;
+    }
+
+    long threads = (long) rows * cols;
+    fprintf(out, "instrumentation over %ld threads:\n", threads);
+    fprintf(out, "  neighbor wait %10.3f ms total, %8.3f ms/thread (%5.1f%%)\n",
+            neighbor * 1e-6, neighbor * 1e-6 / threads, 100.0 * neighbor / total);
+    fprintf(out, "  barrier wait  %10.3f ms total, %8.3f ms/thread (%5.1f%%)\n",
+            barrier * 1e-6, barrier * 1e-6 / threads, 100.0 * barrier / total);
+    fprintf(out, "  compute       %10.3f ms total, %8.3f ms/thread (%5.1f%%)\n",
+            compute * 1e-6, compute * 1e-6 / threads, 100.0 * compute / total);
+    fprintf(out, "  blocked neighbor waits: %ld\n", blocked);
+    fprintf(out, "  longest neighbor wait: element (%d, %d), %.3f ms\n",
+            worst / ncols, worst % ncols, stats[worst].neighbor_wait_ns * 1e-6);
+
+    // Average the neighbor-wait time over blocks of elements.
+    int hrows = rows < HEATMAP_MAX_ROWS ? rows : HEATMAP_MAX_ROWS;
+    int hcols = cols < HEATMAP_MAX_COLS ? cols : HEATMAP_MAX_COLS;
+
+    double *heat = calloc((size_t) hrows * hcols, sizeof(double));
+    int *count = calloc((size_t) hrows * hcols, sizeof(int));
+    double max_heat = 0;
+
+    for(int r=0; r < rows; r++){
+        for(int c=0; c < cols; c++){
+
+            int h = (int)((long) r * hrows / rows) * hcols + (int)((long) c * hcols / cols);
+            heat[h] += stats[r * ncols + c].neighbor_wait_ns;
+            count[h]++;
+        }
+    }
+
+    for(int h=0; h < hrows * hcols; h++){
+
+        heat[h] /= count[h] > 0 ? count[h] : 1;
+        if(heat[h] > max_heat){
+            max_heat = heat[h];
+        }
+    }
+
+    int levels = (int) sizeof(SHADES) - 2;
+    fprintf(out, "  neighbor wait heatmap (north-west at top left, '%c' = %.3f ms):\n",
+            SHADES[levels], max_heat * 1e-6);
+
+    for(int hr=0; hr < hrows; hr++){
+
+        fputs("  |", out);
+        for(int hc=0; hc < hcols; hc++){
+
+            int level = max_heat > 0 ? (int)(heat[hr * hcols + hc] / max_heat * levels + 0.5) : 0;
+            fputc(SHADES[level], out);
+        }
+        fputs("|\n", out);
+    }
+
+    free(heat);
+    free(count);
+}
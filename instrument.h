@@ -0,0 +1,73 @@
+#ifndef INSTRUMENT_H
+#define INSTRUMENT_H
+
+/*
+ * instrument.h
+ *
+ * Optional hot-path instrumentation for the per-element engines, compiled in with
+ * -DWF_INSTRUMENT ("make INSTRUMENT=1"). Each thread accumulates the time it spends
+ * waiting on its neighbors, waiting at the barrier, and computing, in its own
+ * cell_stats. After the threads are joined, instrumentReport() combines them and prints
+ * a summary, including a heatmap of neighbor-wait time over the grid.
+ *
+ * Without WF_INSTRUMENT, the INSTR_* macros expand to nothing. The timer uses
+ * clock_gettime(), so files that include this header need _POSIX_C_SOURCE.
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+
+// Counters for one element's thread.
+typedef struct{
+
+    uint64_t neighbor_wait_ns;  // waiting for the east, south, and south-east neighbors
+                                // (and, when pipelined, for the readers of the last sum)
+    uint64_t barrier_wait_ns;   // waiting in barrier_wait()
+    uint64_t compute_ns;        // computing and publishing the sum
+    long blocked_waits;         // neighbor waits that found the neighbor not yet ready
+} cell_stats;
+
+
+#ifdef WF_INSTRUMENT
+
+/** Return the monotonic clock in nanoseconds.*/
+static inline uint64_t instrNow(){
+
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t) ts.tv_sec * 1000000000u + (uint64_t) ts.tv_nsec;
+}
+
+// Start a timer in a new variable t.
+#define INSTR_START(t)              uint64_t t = instrNow()
+
+// Charge the time since t to a counter of st, and restart t.
+#define INSTR_CHARGE(st, field, t)  do{ uint64_t now_ = instrNow(); \
+                                        (st)->field += now_ - (t); (t) = now_; } while(0)
+
+// Count a neighbor wait that is about to block.
+#define INSTR_COUNT_WAIT(st, sa, idx, epoch) \
+                                    ((st)->blocked_waits += !neighborReady((sa), (idx), (epoch)))
+
+#else
+
+#define INSTR_START(t)
+#define INSTR_CHARGE(st, field, t)
+#define INSTR_COUNT_WAIT(st, sa, idx, epoch)
+
+#endif
+
+
+/** Print totals and a heatmap of the per-element counters.
+ *
+ *  @param stats the counters, indexed like the state array (border entries are ignored)
+ *  @param nrows number of rows in the state array
+ *  @param ncols number of columns in the state array
+ *  @param out the stream to print to
+ */
+void instrumentReport(const cell_stats *stats, int nrows, int ncols, FILE *out);
+
+
+#endif
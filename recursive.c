@@ -0,0 +1,400 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "barrier.h"
+#include "state_array.h"
+#include "recursive.h"
+#include "simd.h"
+#include "value.h"
+#include "report.h"
+#include "wspool.h"
+#include "affinity.h"
+
+/** The recursion is laid out ahead of time as a tree of regions, built once per call.
+ *  Region 0 is the whole interior, and each region that is larger than a leaf has up to
+ *  four quadrants; a region that is only too tall (or too wide) is split in two, and the
+ *  missing quadrants are left out. The quadrants of a region run in three stages:
+ *
+ *      stage 0     SE
+ *      stage 1     NE and SW, which only depend on SE
+ *      stage 2     NW, which depends on all three
+ *
+ *  Every region is one task on the pool. A leaf's task computes the leaf and reports it
+ *  done to its parent; an interior region's task only starts its first stage. The last
+ *  quadrant of a stage to finish starts the next stage, and the last quadrant of the last
+ *  stage reports the region itself done, so the recursion unwinds on whichever worker
+ *  finished the work below it. A round is over when all of the tasks have run.
+ *
+ *  Workers pop the tasks they push last, so each one goes depth first into the quadrant it
+ *  just started, while idle workers steal the oldest (and largest) regions from the top of
+ *  the other deques.
+ */
+
+
+
+// The quadrants of a region.
+enum{ QUAD_SE, QUAD_NE, QUAD_SW, QUAD_NW, NUM_QUADS };
+
+// A region of interior elements, and the progress of its quadrants in the current round.
+typedef struct{
+
+    int r0, c0;             // north-west element of the region (inclusive)
+    int r1, c1;             // south-east bound of the region (exclusive)
+    int parent;             // the region this is a quadrant of, or -1 for region 0
+    int quad[NUM_QUADS];    // the quadrants, or -1 where there is none (all -1 for a leaf)
+
+    int stage;              // the stage of the quadrants running now
+    atomic_int pending;     // quadrants of that stage not yet done
+} region;
+
+// One call of the engine: the regions, the pool, and the state array they cover.
+typedef struct{
+
+    region *regions;
+    int num_regions;
+    int leaf_rows, leaf_cols;
+
+    wspool *pool;
+    value_t *scratch;       // simdBlock() space for each worker, scratch_len values apiece
+    int scratch_len;
+    state_array_t *sa;
+    int rounds_left;        // rounds not yet started
+    value_t result;         // element 0 of the last completed round
+
+    int numRounds;
+    barrier_t barrier;
+    gate_t gate;            // holds the workers back until all of them are created
+} recursive_job;
+
+// A struct for passing arguments to a worker thread.
+typedef struct{
+
+    recursive_job *job;
+    int worker;
+    int cpu;                // the CPU to pin this worker to, or -1 to leave it unpinned
+} recursive_worker;
+
+
+// The quadrants of each stage.
+static const int stage_quads[3][2] = {
+    { QUAD_SE, -1 }, { QUAD_NE, QUAD_SW }, { QUAD_NW, -1 }
+};
+
+
+
+/** Lay out the region from (r0, c0) to (r1, c1) and everything below it in regions,
+ *  starting at entry *next. With regions NULL, only *next is advanced, which counts the
+ *  regions.
+ *  @return the index of the region
+ */
+static int buildRegions(region *regions, int *next, const recursive_job *job,
+                        int r0, int c0, int r1, int c1, int parent){
+
+    int idx = (*next)++;
+
+    int split_rows = (r1 - r0 > job->leaf_rows);
+    int split_cols = (c1 - c0 > job->leaf_cols);
+
+    // The south and east halves take the middle, so a region that isn't split in one
+    // dimension is all "south" (or "east") in it.
+    int rm = split_rows ? r0 + (r1 - r0) / 2 : r0;
+    int cm = split_cols ? c0 + (c1 - c0) / 2 : c0;
+
+    int quad[NUM_QUADS] = { -1, -1, -1, -1 };
+    if(split_rows || split_cols){
+
+        quad[QUAD_SE] = buildRegions(regions, next, job, rm, cm, r1, c1, idx);
+        if(split_rows){
+            quad[QUAD_NE] = buildRegions(regions, next, job, r0, cm, rm, c1, idx);
+        }
+        if(split_cols){
+            quad[QUAD_SW] = buildRegions(regions, next, job, rm, c0, r1, cm, idx);
+        }
+        if(split_rows && split_cols){
+            quad[QUAD_NW] = buildRegions(regions, next, job, r0, c0, rm, cm, idx);
+        }
+    }
+
+    if(regions != NULL){
+
+        region *n = &regions[idx];
+        n->r0 = r0;
+        n->c0 = c0;
+        n->r1 = r1;
+        n->c1 = c1;
+        n->parent = parent;
+        for(int q=0; q < NUM_QUADS; q++){
+            n->quad[q] = quad[q];
+        }
+        n->stage = 0;
+        atomic_init(&n->pending, 0);
+    }
+
+    return idx;
+}
+
+
+static void finishRegion(recursive_job *job, int worker, int idx);
+
+/** Start the first stage of a region, from the given one on, that has any quadrants, by
+ *  pushing them onto the worker's deque. If there is none left, the region is done.
+ */
+static void startStage(recursive_job *job, int worker, int idx, int stage){
+
+    region *n = &job->regions[idx];
+
+    for(; stage < 3; stage++){
+
+        int count = 0;
+        for(int i=0; i < 2; i++){
+            int q = stage_quads[stage][i];
+            count += (q >= 0 && n->quad[q] >= 0);
+        }
+        if(count == 0){
+            continue;
+        }
+
+        // The count must be in place before the first quadrant can finish.
+        n->stage = stage;
+        atomic_store_explicit(&n->pending, count, memory_order_relaxed);
+        for(int i=0; i < 2; i++){
+            int q = stage_quads[stage][i];
+            if(q >= 0 && n->quad[q] >= 0){
+                wspoolPush(job->pool, worker, n->quad[q]);
+            }
+        }
+        return;
+    }
+
+    finishRegion(job, worker, idx);
+}
+
+
+/** Report a region done to its parent, starting the parent's next stage if the region was
+ *  the last quadrant of the current one.
+ */
+static void finishRegion(recursive_job *job, int worker, int idx){
+
+    int p = job->regions[idx].parent;
+    if(p < 0){
+        return;
+    }
+
+    region *parent = &job->regions[p];
+    if(atomic_fetch_sub_explicit(&parent->pending, 1, memory_order_acq_rel) == 1){
+        startStage(job, worker, p, parent->stage + 1);
+    }
+}
+
+
+/** The task function run by the pool: compute a leaf, or start the quadrants of a larger
+ *  region. The context pointer is the job.
+ */
+static void runRegion(wspool *pool, int worker, int idx, void *ctx){
+
+    recursive_job *job = (recursive_job *) ctx;
+    const region *n = &job->regions[idx];
+
+    if(n->quad[QUAD_SE] >= 0){
+        startStage(job, worker, idx, 0);
+        return;
+    }
+
+    value_t *sum = getSumPlane(job->sa);
+    grid_t g = getGrid(job->sa);
+
+    // The element south-east of the leaf is (r1, c1).
+    simdBlock(&sum[gridIndex(g, n->r0, n->c0)], gridStride(g), n->r1 - n->r0, n->c1 - n->c0,
+              gridRows(g) - 1 - n->r1, gridCols(g) - 1 - n->c1,
+              job->scratch + (size_t) worker * job->scratch_len);
+
+    finishRegion(job, worker, idx);
+}
+
+
+/** Executed by the last thread into the barrier, with the job as its argument. Records the
+ *  result of the round (if one was running), and announces the regions of the next one,
+ *  seeding the pool with region 0.
+ */
+static void * recursiveBarrierFunction(void * a){
+
+    recursive_job *job = (recursive_job *) a;
+
+    job->result = getSumPlane(job->sa)[0];
+
+    if(job->rounds_left > 0 && job->num_regions > 0){
+
+        job->rounds_left--;
+        wspoolBegin(job->pool, job->num_regions);
+        wspoolPush(job->pool, 0, 0);
+    }
+
+    return NULL;
+}
+
+
+/** The worker thread function: run the tasks of each round, with a barrier between
+ *  rounds.
+ */
+static void * recursiveWorker(void * a){
+
+    recursive_worker *args = (recursive_worker *) a;
+    recursive_job *job = args->job;
+
+    if(!gate_wait(&job->gate)){
+        return NULL;
+    }
+
+    if(args->cpu >= 0){
+        affinityPin(args->cpu);
+    }
+
+    barrier_wait_id(&job->barrier, args->worker, job);
+
+    for(int round=0; round < job->numRounds; round++){
+
+        wspoolRun(job->pool, args->worker);
+        barrier_wait_id(&job->barrier, args->worker, job);
+    }
+
+    return NULL;
+}
+
+
+int recursiveWavefront(state_array_t **sa, int num_state_rows, int num_state_cols,
+                       int numRounds, const engine_opts *opts){
+
+    *sa = acquireStateArray(*sa, num_state_rows, num_state_cols, opts->affinity);
+    if(*sa == NULL){
+        return EXIT_FAILURE;
+    }
+    initBorders(*sa);
+
+    recursive_job job;
+    job.sa = *sa;
+    job.leaf_rows = opts->tile_rows > 0 ? opts->tile_rows : RECURSIVE_LEAF_SIZE;
+    job.leaf_cols = opts->tile_cols > 0 ? opts->tile_cols : job.leaf_rows;
+    job.numRounds = numRounds;
+    job.rounds_left = numRounds;
+
+    // An array with one row or column has no interior, and no regions.
+    int interior_rows = num_state_rows - 1;
+    int interior_cols = num_state_cols - 1;
+
+    job.num_regions = 0;
+    job.regions = NULL;
+    if(interior_rows > 0 && interior_cols > 0){
+
+        buildRegions(NULL, &job.num_regions, &job, 0, 0, interior_rows, interior_cols, -1);
+        job.regions = malloc(job.num_regions * sizeof(region));
+        if(job.regions == NULL){
+            return EXIT_FAILURE;
+        }
+
+        int next = 0;
+        buildRegions(job.regions, &next, &job, 0, 0, interior_rows, interior_cols, -1);
+    }
+
+    int num_threads = opts->num_threads;
+    if(num_threads <= 0){
+        num_threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    if(num_threads > job.num_regions){
+        num_threads = job.num_regions;
+    }
+    if(num_threads < 1){
+        num_threads = 1;
+    }
+
+    job.scratch_len = 3 * (job.leaf_rows + 1);
+    job.scratch = malloc((size_t) num_threads * job.scratch_len * sizeof(value_t));
+    job.pool = wspoolCreate(num_threads, job.num_regions, runRegion, &job);
+
+    pthread_t *thread_arr = malloc(num_threads * sizeof(pthread_t));
+    recursive_worker *args = malloc(num_threads * sizeof(recursive_worker));
+
+    int have_gate = 0, have_barrier = 0;
+    if(job.scratch != NULL && job.pool != NULL && thread_arr != NULL && args != NULL){
+
+        have_gate = (gate_init(&job.gate) == 0);
+        have_barrier = have_gate &&
+            barrier_init_kind(&job.barrier, num_threads + 1, recursiveBarrierFunction,
+                              opts->barrier) == 0;
+    }
+
+    if(!have_barrier){
+
+        if(have_gate){
+            gate_destroy(&job.gate);
+        }
+        if(job.pool != NULL){
+            wspoolDestroy(job.pool);
+        }
+        free(job.scratch);
+        free(job.regions);
+        free(thread_arr);
+        free(args);
+        return EXIT_FAILURE;
+    }
+
+    if(opts->affinity){
+        affinityReport(stderr, num_threads, num_state_rows);
+    }
+
+    int started = 0;
+    for(; started < num_threads; started++){
+
+        args[started].job = &job;
+        args[started].worker = started;
+        args[started].cpu = opts->affinity ? affinityCpu(started, num_threads) : -1;
+
+        if(pthread_create(&thread_arr[started], NULL, recursiveWorker, &args[started]) != 0){
+            break;
+        }
+    }
+
+    // The barrier counts every worker, so if one couldn't be created, the others are sent
+    // home from the gate, and no round is run.
+    int status = (started == num_threads) ? EXIT_SUCCESS : EXIT_FAILURE;
+    gate_open(&job.gate, status == EXIT_SUCCESS);
+
+    if(status == EXIT_SUCCESS){
+
+        // The first barrier starts the first round, and each later one ends a round.
+        barrier_wait_id(&job.barrier, num_threads, &job);
+
+        for(int round=0; round < numRounds; round++){
+
+            barrier_wait_id(&job.barrier, num_threads, &job);
+            reportRound(round, job.result);
+        }
+    }
+
+    for(int i=0; i < started; i++){
+
+        if(pthread_join(thread_arr[i], NULL) != 0){
+            status = EXIT_FAILURE;
+        }
+    }
+
+    if(opts->stats && started == num_threads){
+        wspoolPrintStats(job.pool, stderr);
+    }
+
+    if(barrier_destroy(&job.barrier) != 0){
+        status = EXIT_FAILURE;
+    }
+    gate_destroy(&job.gate);
+    wspoolDestroy(job.pool);
+    free(job.scratch);
+    free(job.regions);
+    free(thread_arr);
+    free(args);
+
+    return status;
+}
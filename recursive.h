@@ -0,0 +1,28 @@
+#ifndef RECURSIVE_H
+#define RECURSIVE_H
+
+#include "wavefront.h"
+
+// Regions of at most this many rows and columns aren't split any further (see
+// engine_opts.tile_rows and tile_cols to change it).
+#define RECURSIVE_LEAF_SIZE 64
+
+/** Run the wavefront computation by recursive division of the interior of the state
+ *  array. A region is split into quadrants, which are computed in dependency order: the
+ *  south-east quadrant first, then the north-east and south-west ones in parallel, and
+ *  the north-west one last. Leaf regions are computed with the diagonal kernel of
+ *  simd.c (see simdBlock()).
+ *
+ *  Each region is a task on the work-stealing pool in wspool.c. The regions at every level
+ *  of the recursion are about half the size of the ones above them, so some level fits
+ *  each level of the cache, whatever the sizes of the caches are.
+ *
+ *  Like cellWavefront(), the engine fills in the whole state array: the array in *sa is
+ *  reused if it is big enough, and replaced otherwise, so *sa holds the array of this
+ *  computation on return. See wavefront() for the other parameters.
+ */
+int recursiveWavefront(state_array_t **sa, int num_state_rows, int num_state_cols,
+                       int numRounds, const engine_opts *opts);
+
+
+#endif
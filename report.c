@@ -0,0 +1,218 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "report.h"
+#include "value.h"
+
+
+// These variables have "static" scope. Results are reported from one thread at a time.
+static value_t * rec_values = NULL;     // NULL when printing
+static double * rec_times = NULL;
+static int rec_capacity = 0;
+static value_t last_result = 0;
+
+static report_mode mode = REPORT_LINES;
+
+static char out_buf[REPORT_BUFFER_SIZE];   // REPORT_BUFFERED: lines not written yet
+static size_t out_len = 0;
+
+static long sum_rounds = 0;                 // REPORT_SUMMARY: rounds since the last flush,
+static value_t sum_first;                   // the result of the first of them,
+static int sum_bad_round = -1;              // the first round that differs (or -1),
+static value_t sum_bad_value;               // and its result
+static double sum_start = 0;                // when the rounds started
+
+
+
+/** Write the buffered lines to standard output.
+ *  @return 0 on success, or -1 on failure
+ */
+static int writeBuffer(){
+
+    // Anything printed through stdio must come out first.
+    fflush(stdout);
+
+    size_t done = 0;
+    while(done < out_len){
+
+        ssize_t n = write(STDOUT_FILENO, out_buf + done, out_len - done);
+        if(n < 0 && errno == EINTR){
+            continue;
+        }
+        if(n < 0){
+            out_len = 0;
+            return -1;
+        }
+        done += (size_t) n;
+    }
+
+    out_len = 0;
+    return 0;
+}
+
+
+/** Print the line of a round in the selected mode.*/
+static void printRound(int round, value_t result, const char *suffix){
+
+    char buf[VALUE_STR_LEN];
+
+    switch(mode){
+
+        case REPORT_LINES:
+            printf("Round %d, result is %s%s\n", round, valueToString(result, buf), suffix);
+            break;
+
+        case REPORT_BUFFERED:
+            // A line is at most 20 + VALUE_STR_LEN + the suffix.
+            if(out_len + 128 > sizeof(out_buf)){
+                writeBuffer();
+            }
+            out_len += snprintf(out_buf + out_len, sizeof(out_buf) - out_len,
+                                "Round %d, result is %s%s\n", round,
+                                valueToString(result, buf), suffix);
+            break;
+
+        case REPORT_SUMMARY:
+            if(sum_rounds == 0){
+                sum_first = result;
+            } else if(result != sum_first && sum_bad_round < 0){
+                sum_bad_round = round;
+                sum_bad_value = result;
+            }
+            sum_rounds++;
+            break;
+    }
+}
+
+
+
+void reportPrint(){
+
+    rec_values = NULL;
+    rec_times = NULL;
+    rec_capacity = 0;
+}
+
+
+void reportRecord(value_t *values, double *times, int capacity){
+
+    rec_values = values;
+    rec_times = times;
+    rec_capacity = capacity;
+}
+
+
+void reportRound(int round, value_t result){
+
+    last_result = result;
+
+    if(rec_values != NULL){
+
+        if(round >= 0 && round < rec_capacity){
+            rec_values[round] = result;
+            rec_times[round] = reportNow();
+        }
+        return;
+    }
+
+    printRound(round, result, "");
+}
+
+
+value_t reportLastResult(){
+
+    return last_result;
+}
+
+
+void reportCachedRound(int round, value_t result){
+
+    if(rec_values != NULL){
+        reportRound(round, result);
+        return;
+    }
+
+    last_result = result;
+
+    printRound(round, result, " (cached)");
+}
+
+
+void reportMode(report_mode m){
+
+    mode = m;
+    sum_start = reportNow();
+}
+
+
+int reportModeFromName(const char *name, report_mode *m){
+
+    if(strcmp(name, "lines") == 0){
+        *m = REPORT_LINES;
+    } else if(strcmp(name, "buffered") == 0){
+        *m = REPORT_BUFFERED;
+    } else if(strcmp(name, "summary") == 0){
+        *m = REPORT_SUMMARY;
+    } else {
+        return -1;
+    }
+
+    return 0;
+}
+
+
+int reportFlush(){
+
+    int status = 0;
+    char buf[VALUE_STR_LEN], bad[VALUE_STR_LEN];
+
+    switch(mode){
+
+        case REPORT_LINES:
+            break;
+
+        case REPORT_BUFFERED:
+            status = writeBuffer();
+            break;
+
+        case REPORT_SUMMARY:
+            if(sum_rounds == 0){
+                break;
+            }
+
+            if(sum_bad_round >= 0){
+
+                printf("Rounds 0-%ld: round %d result is %s, but round 0 result is %s\n",
+                       sum_rounds - 1, sum_bad_round, valueToString(sum_bad_value, bad),
+                       valueToString(sum_first, buf));
+                status = -1;
+            } else {
+
+                double elapsed = reportNow() - sum_start;
+                printf("Rounds 0-%ld, result is %s (%.6f s, %.1f rounds/s)\n",
+                       sum_rounds - 1, valueToString(sum_first, buf), elapsed,
+                       elapsed > 0 ? sum_rounds / elapsed : 0.0);
+            }
+            break;
+    }
+
+    sum_rounds = 0;
+    sum_bad_round = -1;
+    sum_start = reportNow();
+
+    return status;
+}
+
+
+double reportNow(){
+
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
@@ -0,0 +1,85 @@
+#ifndef REPORT_H
+#define REPORT_H
+
+#include "value.h"
+
+/*
+ * report.h
+ *
+ * Every engine hands the result of each round to reportRound(), in round order, from a
+ * single thread. By default the result is printed as "Round r, result is X". The
+ * benchmark harness instead asks for the results to be recorded, along with the time at
+ * which each round completed.
+ *
+ * Printed results go out in one of three modes (see reportMode()). With millions of rounds
+ * on a small grid, a line per round through stdio can cost more than the rounds, so the
+ * buffered mode formats the lines into a preallocated buffer that is written with one
+ * write() per REPORT_BUFFER_SIZE bytes, and the summary mode prints nothing per round.
+ */
+
+typedef enum{
+
+    REPORT_LINES,       // print each line with printf() as it is reported (the default)
+    REPORT_BUFFERED,    // the same lines, written in large chunks by reportFlush()
+    REPORT_SUMMARY      // one line per computation, checking that all rounds agree
+} report_mode;
+
+// The size of the buffer of the buffered mode.
+#define REPORT_BUFFER_SIZE (1 << 16)
+
+
+/** Print each result as it is reported, in the selected mode. This is the default.*/
+void reportPrint();
+
+/** Select how printed results are written. Rounds reported before the change should be
+ *  flushed first.
+ */
+void reportMode(report_mode mode);
+
+/** Look up a mode by name ("lines", "buffered", or "summary").
+ *  @return 0 on success, or -1 if there is no such mode
+ */
+int reportModeFromName(const char *name, report_mode *mode);
+
+/** Finish the output of a computation. In the buffered mode, write out the buffer. In the
+ *  summary mode, print one line for the rounds reported since the last flush: their
+ *  number, their result, and their throughput since the last flush, or the first round
+ *  whose result differs from round 0's.
+ *
+ *  @return 0 on success, or -1 if the rounds didn't all agree or the output failed
+ */
+int reportFlush();
+
+/** Record results instead of printing them. Round r's result is stored in values[r] and
+ *  its completion time (in seconds, see reportNow()) in times[r]. Rounds beyond capacity
+ *  are dropped.
+ *
+ *  @param values where to store the results
+ *  @param times where to store the completion times
+ *  @param capacity the number of entries in values and times
+ */
+void reportRecord(value_t *values, double *times, int capacity);
+
+/** Report the result of a round.
+ *
+ *  @param round the round number
+ *  @param result the sum of element 0 in that round
+ */
+void reportRound(int round, value_t result);
+
+/** Report the result of a round that was found in the result cache (see cache.h) rather
+ *  than computed. It is printed with a "(cached)" suffix, and recorded like any other.
+ *
+ *  @param round the round number
+ *  @param result the cached result
+ */
+void reportCachedRound(int round, value_t result);
+
+/** Return the result most recently passed to reportRound().*/
+value_t reportLastResult();
+
+/** Return the current time of the monotonic clock in seconds.*/
+double reportNow();
+
+
+#endif
@@ -0,0 +1,198 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "simd.h"
+#include "grid.h"
+#include "value.h"
+#include "stencil.h"
+#include "report.h"
+
+/** The diagonal kernel works in coordinates measured from the south-east corner: the
+ *  element at (row, col) of the state array is at r = nrows-1-row, c = ncols-1-col. The
+ *  border elements are then the ones with r == 0 or c == 0, and element 0 is at
+ *  (nrows-1, ncols-1).
+ *
+ *  These are also the positions the stencil takes (see stencil.h).
+ *
+ *  Anti-diagonal k holds the elements with r + c == k, and each diagonal is stored indexed
+ *  by r. An interior element on diagonal k is
+ *
+ *      D[k][r] = D[k-1][r-1] + D[k-1][r] + D[k-2][r-1]
+ *
+ *  (its south, east, and south-east neighbors), which is a contiguous vector add over r.
+ *  Other stencils combine the same three neighbors, so their loop over r has no
+ *  dependences either, and is left for the compiler to vectorize.
+ */
+
+
+
+// The vector paths only apply to plain wrapping adds, which are the same for signed and
+// unsigned lanes. The modular type needs a compare and subtract per lane, there are no
+// 128-bit lanes, and other stencils aren't adds, so those builds use the scalar loop (which
+// the compiler may still vectorize on its own).
+#if defined(VALUE_MOD) || defined(VALUE_INT128) || !defined(STENCIL_DELANNOY)
+#define SIMD_LANES 0
+#elif defined(__AVX512F__)
+#define SIMD_LANES (512 / VALUE_BITS)
+#elif defined(__AVX2__)
+#define SIMD_LANES (256 / VALUE_BITS)
+#elif defined(__ARM_NEON)
+#define SIMD_LANES (128 / VALUE_BITS)
+#else
+#define SIMD_LANES 0
+#endif
+
+
+/** Compute out[r] from its neighbors d1[r] (east), d1[r-1] (south), and d2[r-1]
+ *  (south-east) for lo <= r <= hi. Element r of the diagonal is at position
+ *  (r0 + r, ck - r) for the stencil.
+ */
+static void combineDiagonal(value_t * restrict out, const value_t * restrict d1,
+                            const value_t * restrict d2, int lo, int hi, int r0, int ck){
+
+    int r = lo;
+
+#if SIMD_LANES > 0
+    for(; r + SIMD_LANES - 1 <= hi; r += SIMD_LANES){
+
+#if defined(__AVX512F__)
+        __m512i a = _mm512_loadu_si512((const void *)(d1 + r - 1));
+        __m512i b = _mm512_loadu_si512((const void *)(d1 + r));
+        __m512i c = _mm512_loadu_si512((const void *)(d2 + r - 1));
+#if defined(VALUE_INT64)
+        __m512i sum = _mm512_add_epi64(_mm512_add_epi64(a, b), c);
+#else
+        __m512i sum = _mm512_add_epi32(_mm512_add_epi32(a, b), c);
+#endif
+        _mm512_storeu_si512((void *)(out + r), sum);
+#elif defined(__AVX2__)
+        __m256i a = _mm256_loadu_si256((const __m256i *)(d1 + r - 1));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(d1 + r));
+        __m256i c = _mm256_loadu_si256((const __m256i *)(d2 + r - 1));
+#if defined(VALUE_INT64)
+        __m256i sum = _mm256_add_epi64(_mm256_add_epi64(a, b), c);
+#else
+        __m256i sum = _mm256_add_epi32(_mm256_add_epi32(a, b), c);
+#endif
+        _mm256_storeu_si256((__m256i *)(out + r), sum);
+#elif defined(__ARM_NEON)
+#if defined(VALUE_INT64)
+        int64x2_t sum = vaddq_s64(vaddq_s64(vld1q_s64(d1 + r - 1), vld1q_s64(d1 + r)),
+                                  vld1q_s64(d2 + r - 1));
+        vst1q_s64(out + r, sum);
+#else
+        int32x4_t sum = vaddq_s32(vaddq_s32(vld1q_s32(d1 + r - 1), vld1q_s32(d1 + r)),
+                                  vld1q_s32(d2 + r - 1));
+        vst1q_s32(out + r, sum);
+#endif
+#endif
+    }
+#endif
+
+    for(; r <= hi; r++){
+        out[r] = stencilCombine(d1[r], d1[r - 1], d2[r - 1], r0 + r, ck - r);
+    }
+}
+
+
+value_t simdSweep(int num_state_rows, int num_state_cols, value_t *diags){
+
+    // With a shape fixed at build time (see grid.h), R and C are constants.
+    grid_t g = gridMake(num_state_rows, num_state_cols);
+    int R = gridRows(g);
+    int C = gridCols(g);
+
+    value_t *cur = diags;           // diagonal k
+    value_t *prev = diags + R;      // diagonal k-1
+    value_t *prev2 = diags + 2 * R; // diagonal k-2
+
+    for(int k=0; k <= R + C - 2; k++){
+
+        // Border elements: r == 0 (the bottom row) and c == 0 (the last column).
+        if(k <= C - 1){
+            cur[0] = stencilBorder(0, k);
+        }
+        if(k <= R - 1){
+            cur[k] = stencilBorder(k, 0);
+        }
+
+        // Interior elements have r >= 1 and c = k - r >= 1.
+        int lo = (k - (C - 1) > 1) ? k - (C - 1) : 1;
+        int hi = (k - 1 < R - 1) ? k - 1 : R - 1;
+        if(lo <= hi){
+            combineDiagonal(cur, prev, prev2, lo, hi, 0, k);
+        }
+
+        value_t *t = prev2;
+        prev2 = prev;
+        prev = cur;
+        cur = t;
+    }
+
+    // The last diagonal computed (now in prev) holds only element 0.
+    return prev[R - 1];
+}
+
+
+void simdBlock(value_t *sum, int stride, int rows, int cols, int r0, int c0, value_t *diags){
+
+    // The block is extended by the row to its south and the column to its east, which are
+    // its inputs. In the coordinates of the kernel, those are the elements with r == 0 or
+    // c == 0, and local element (r, c) is at sum[(rows - r) * stride + (cols - c)], and at
+    // (r0 + r, c0 + c) for the stencil.
+    value_t *cur = diags;
+    value_t *prev = diags + (rows + 1);
+    value_t *prev2 = diags + 2 * (rows + 1);
+
+    for(int k=0; k <= rows + cols; k++){
+
+        if(k <= cols){
+            cur[0] = sum[(size_t) rows * stride + (cols - k)];
+        }
+        if(k <= rows){
+            cur[k] = sum[(size_t)(rows - k) * stride + cols];
+        }
+
+        int lo = (k - cols > 1) ? k - cols : 1;
+        int hi = (k - 1 < rows) ? k - 1 : rows;
+        if(lo <= hi){
+
+            combineDiagonal(cur, prev, prev2, lo, hi, r0, c0 + k);
+            for(int r=lo; r <= hi; r++){
+                sum[(size_t)(rows - r) * stride + (cols - (k - r))] = cur[r];
+            }
+        }
+
+        value_t *t = prev2;
+        prev2 = prev;
+        prev = cur;
+        cur = t;
+    }
+}
+
+
+int simdWavefront(int num_state_rows, int num_state_cols, int numRounds, const engine_opts *opts){
+
+    value_t *diags = malloc(3 * (size_t) num_state_rows * sizeof(value_t));
+    if(diags == NULL){
+        return EXIT_FAILURE;
+    }
+
+    for(int round=0; round < numRounds; round++){
+
+        value_t result = simdSweep(num_state_rows, num_state_cols, diags);
+
+        reportRound(round, result);
+    }
+
+    free(diags);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,43 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+#include "value.h"
+#include "wavefront.h"
+
+/** Run the wavefront computation serially on the calling thread, one anti-diagonal at a
+ *  time. Elements on an anti-diagonal are independent of each other and depend only on the
+ *  previous two diagonals, so only three diagonals are kept, and each one is computed with
+ *  vector adds (AVX-512, AVX2 or NEON when the compiler targets them). Stencils other than
+ *  the default one (see stencil.h) are vectorized by the compiler, if at all.
+ *
+ *  This engine doesn't use the state array. See wavefront() for the parameters.
+ */
+int simdWavefront(int num_state_rows, int num_state_cols, int numRounds, const engine_opts *opts);
+
+/** Compute the result (element 0) of a single round with the diagonal kernel.
+ *
+ *  @param num_state_rows number of rows in the state array
+ *  @param num_state_cols number of columns in the state array
+ *  @param diags scratch space for 3 * num_state_rows values
+ *  @return the sum of element 0
+ */
+value_t simdSweep(int num_state_rows, int num_state_cols, value_t *diags);
+
+/** Compute a rows x cols block of a sum plane with the diagonal kernel. The row just south
+ *  of the block and the column just east of it (including the element south-east of the
+ *  block) must already hold their sums. The diagonals are computed in scratch space and
+ *  each one is stored back into the plane, so the block is left in place.
+ *
+ *  @param sum the north-west element of the block
+ *  @param stride the number of elements per row of the plane
+ *  @param rows number of rows in the block
+ *  @param cols number of columns in the block
+ *  @param r0 the row of the element south-east of the block, counted from the south-east
+ *      corner of the state array (see stencil.h)
+ *  @param c0 its column, counted the same way
+ *  @param diags scratch space for 3 * (rows + 1) values
+ */
+void simdBlock(value_t *sum, int stride, int rows, int cols, int r0, int c0, value_t *diags);
+
+
+#endif
@@ -1,16 +1,31 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
 #include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
 
 #include "state_array.h"
-
-/** This C code contains several functions that work with a "state array" that is declared
- *  statically in this file. That is, there is only one state array, and the functions work
- *  on that single instance. Of course, you'll want to call createStateArray() before doing
- *  much else.
+#include "futex.h"
+#include "affinity.h"
+#include "alloc.h"
+#include "stencil.h"
+
+/** This C code contains several functions that work with a "state array". Each array is
+ *  reached through a state_array_t handle returned by createStateArray(), and every
+ *  function takes the handle of the array to work on, so any number of arrays (and of
+ *  computations on them) can exist side by side.
+ *
+ *  The state array is stored as two separate "planes" of arr_len entries each: the sum plane
+ *  holds the sum of every element, and the sync plane holds the "state" struct (see
+ *  state_array.h) used to wait for an element to become ready. Keeping the sums contiguous
+ *  means a neighbor read only pulls sums into the cache, and resetting the array is a
+ *  memset() of each plane. Both planes are aligned to a cache line.
  *
- *  Each element of the state array is of type "state", as found in state_arr.h.  Although
- *  it is useful to think of the array as two dimensional, C really only supports 1-D arrays.
+ *  Although it is useful to think of the array as two dimensional, C really only supports 1-D arrays.
  *  However, we can map (row, column) coordinates to a 1D "index" very easily when necessary.
  *  But if we want to "visit" every element (like for initialization), it's simpler to stick
  *  with the 1D index.
@@ -30,62 +45,337 @@
  *      B B B B B B
  *
  *          S
+ *
+ *  By default, each element publishes its sum through an atomic epoch (see state_array.h).
+ *  Compiling with -DSTATE_SYNC_MUTEX selects the original layout, in which each element has
+ *  its own mutex and condition variable.
+ *
+ *  Each row takes up a padded stride of elements in both planes (see allocRowStride()), so
+ *  rows start on a cache line. The planes come from allocBlock(), which can put them on
+ *  huge pages, and which hands out zeroed pages straight from the kernel for large sizes.
+ *  A zero epoch is a valid, not-yet-ready epoch, so a new array in
+ *  the atomic build needs no initialization at all: its pages are only touched (and
+ *  placed) when the engine first writes them. The mutex build has to initialize every
+ *  element's mutex and condition variable, which is done by several threads at once.
  */
 
 
 
 
-// These variables have "static" scope, meaning they are only visible
-// inside this file. Currently, only one state array can be created.
-state * state_arr=NULL;  // The state array.
-int nrows, ncols;        // The number of rows and columns in the state array.
-int arr_len = 0;         // The total number of elements in the state array.
+// A state array. Its layout is private to this file.
+struct state_array{
+
+    value_t * sum_plane; // The sum of each element.
+    state * sync_plane;  // The synchronization data of each element.
+    alloc_block sum_block, sync_block; // The planes' memory (sum_block.ptr is NULL if the
+                                       // sums aren't ours).
+    int nrows, ncols;    // The number of rows and columns in the state array.
+    int stride;          // The number of elements per row, including padding.
+    int padded;          // Rows are padded; sums given by the caller are not.
+    int arr_len;         // The total number of elements in the state array, padding included.
+    int arr_cap;         // The number of elements allocated and initialized in each plane.
+};
+
+
+_Static_assert(ALLOC_ALIGN % CACHE_LINE == 0, "planes must be aligned to a cache line");
+
 
 
 
+// Arrays with fewer elements than this are initialized by the calling thread alone.
+#define PARALLEL_INIT_MIN 65536
+
+/** Return the row stride for a padded or unpadded array with _ncols columns. A shape
+ *  fixed at build time (see grid.h) has unpadded rows.
+ */
+static int rowStride(int _ncols, int padded){
+
+#ifdef GRID_COLS
+    (void) padded;
+    return _ncols;
+#else
+    return padded ? allocRowStride(_ncols, sizeof(value_t)) : _ncols;
+#endif
+}
+
+
+/** Allocate the planes of a state array with the specified number of rows and columns,
+ *  without touching them. The sum plane is allocated too unless sums is given.
+ */
+static state_array_t * allocStateArray(int _nrows, int _ncols, value_t *sums){
+
+    state_array_t *sa = malloc(sizeof(state_array_t));
+    if(sa == NULL){
+        return NULL;
+    }
+
+    sa->nrows = _nrows;
+    sa->ncols = _ncols;
+    sa->padded = (sums == NULL);
+    sa->stride = rowStride(_ncols, sa->padded);
+
+    sa->arr_len = sa->nrows * sa->stride;
+    sa->arr_cap = sa->arr_len;
+    // printf("Initializing State Array. Arr len is %d\n", sa->arr_len);
+
+    sa->sum_block.ptr = NULL;
+    sa->sum_plane = sums != NULL ? sums
+                  : allocBlock(&sa->sum_block, (size_t) sa->arr_len * sizeof(value_t));
+    sa->sync_plane = allocBlock(&sa->sync_block, (size_t) sa->arr_len * sizeof(state));
+
+    if(sa->sum_plane == NULL || sa->sync_plane == NULL){
+        allocFree(&sa->sum_block);
+        allocFree(&sa->sync_block);
+        free(sa);
+        return NULL;
+    }
+
+    return sa;
+}
+
+
+/** For each element in rows [r0, r1), initialize the synchronization data members, and set
+ *  the sum and epoch to 0. This is the first write to those rows, so their pages are placed
+ *  on the node of the calling thread.
+ */
+static void initStateRows(state_array_t *sa, int r0, int r1){
+
+    if(r1 <= r0){
+        return;
+    }
+
+    int begin = r0 * sa->stride;
+    int end = r1 * sa->stride;
+
+    memset(&sa->sum_plane[begin], 0, (end - begin) * sizeof(value_t));
+
+    for(int i=begin; i < end; i++){
+
+#ifdef STATE_SYNC_MUTEX
+        pthread_cond_init(&(sa->sync_plane[i].cv), NULL);
+        pthread_mutex_init(&(sa->sync_plane[i].lock), NULL);
+        sa->sync_plane[i].epoch = 0;
+#else
+        atomic_init(&(sa->sync_plane[i].epoch), 0);
+#endif
+    }
+}
+
+
+#ifdef STATE_SYNC_MUTEX
+
+// A band of rows for one of the threads of initParallel().
+typedef struct{
+
+    state_array_t *sa;
+    int r0, r1;
+    pthread_t thread;
+} init_band;
+
+static void * initBand(void *a){
+
+    init_band *b = (init_band *) a;
+    initStateRows(b->sa, b->r0, b->r1);
+
+    return NULL;
+}
+
+
+/** Initialize every element of a new array, splitting the rows between one thread per
+ *  online CPU. Bands whose thread can't be started are initialized here.
+ */
+static void initParallel(state_array_t *sa){
+
+    int n = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    if(n > sa->nrows) n = sa->nrows;
+
+    if(n <= 1 || sa->arr_len < PARALLEL_INIT_MIN){
+        initStateRows(sa, 0, sa->nrows);
+        return;
+    }
+
+    init_band *bands = malloc(n * sizeof(init_band));
+    if(bands == NULL){
+        initStateRows(sa, 0, sa->nrows);
+        return;
+    }
+
+    int *started = calloc(n, sizeof(int));
+
+    for(int i=0; i < n; i++){
+
+        bands[i].sa = sa;
+        bands[i].r0 = (int)((long) sa->nrows * i / n);
+        bands[i].r1 = (int)((long) sa->nrows * (i + 1) / n);
+
+        // Band 0 is this thread's own.
+        if(i > 0 && started != NULL){
+            started[i] = (pthread_create(&bands[i].thread, NULL, initBand, &bands[i]) == 0);
+        }
+    }
+
+    for(int i=0; i < n; i++){
+        if(started == NULL || !started[i]){
+            initBand(&bands[i]);
+        }
+    }
+    for(int i=1; i < n; i++){
+        if(started != NULL && started[i]){
+            pthread_join(bands[i].thread, NULL);
+        }
+    }
+
+    free(started);
+    free(bands);
+}
+
+#endif
+
 
 /** Allocate a new state array with the specified number of rows and columns. For
- *  each element, the "condition variable" and "mutex" data members are initialized, and
- *  the sum is set to 0.
+ *  each element, the synchronization data members are initialized, and the sum and epoch
+ *  are set to 0.
  *
  *  @param _nrows number of rows in the new array
  *  @param _ncols number of columns in the new array
+ *  @return the new array, or NULL if it couldn't be allocated
  */
-void createStateArray(int _nrows, int _ncols){
+state_array_t * createStateArray(int _nrows, int _ncols){
+
+    state_array_t *sa = allocStateArray(_nrows, _ncols, NULL);
 
-    nrows = _nrows;
-    ncols = _ncols;
+#ifdef STATE_SYNC_MUTEX
+    if(sa != NULL){
+        initParallel(sa);
+    }
+#endif
+    // Otherwise, calloc() has already set every sum and epoch to 0.
 
-    arr_len = nrows * ncols;
-    // printf("Initializing State Array. Arr len is %d\n", arr_len);
+    return sa;
+}
 
-    state_arr = malloc(arr_len * sizeof(state));
 
-    for(int i=0; i < arr_len; i++){
+state_array_t * createStateArrayOver(int _nrows, int _ncols, value_t *sums){
 
-        pthread_cond_init(&(state_arr[i].cv), NULL);
-        pthread_mutex_init(&(state_arr[i].lock), NULL);
+    // The sums need no initial value; an element's epoch says when its sum is valid.
+    state_array_t *sa = allocStateArray(_nrows, _ncols, sums);
 
-        state_arr[i].sum = 0;
+#ifdef STATE_SYNC_MUTEX
+    if(sa != NULL){
+        initParallel(sa);
     }
+#endif
+
+    return sa;
 }
 
-/** Return a reference to the state array.*/
-state * getStateArray(){
 
-    return state_arr;
+/** Initialize the band of rows that belongs to a node (see affinityBand()).*/
+static void initNodeBand(int node, void *ctx){
+
+    state_array_t *sa = (state_array_t *) ctx;
+
+    int r0, r1;
+    affinityBand(node, sa->nrows, &r0, &r1);
+    initStateRows(sa, r0, r1);
+}
+
+
+state_array_t * createStateArrayOnNodes(int _nrows, int _ncols){
+
+    state_array_t *sa = allocStateArray(_nrows, _ncols, NULL);
+
+    // Every band is touched once, by its node's thread or (if that couldn't be started)
+    // by this one, so no row is initialized twice.
+    if(sa != NULL){
+        affinityOnNodes(initNodeBand, sa);
+    }
+
+    return sa;
+}
+
+int reshapeStateArray(state_array_t *sa, int _nrows, int _ncols){
+
+    if(sa == NULL || (long) _nrows * rowStride(_ncols, sa->padded) > sa->arr_cap){
+        return -1;
+    }
+
+    sa->nrows = _nrows;
+    sa->ncols = _ncols;
+    sa->stride = rowStride(_ncols, sa->padded);
+    sa->arr_len = sa->nrows * sa->stride;
+
+    resetStateArray(sa);
+
+    return 0;
+}
+
+state_array_t * acquireStateArray(state_array_t *sa, int _nrows, int _ncols, int on_nodes){
+
+    if(reshapeStateArray(sa, _nrows, _ncols) == 0){
+        return sa;
+    }
+
+    destroyStateArray(sa);
+
+    if(on_nodes){
+        return createStateArrayOnNodes(_nrows, _ncols);
+    } else {
+        return createStateArray(_nrows, _ncols);
+    }
+}
+
+grid_t getGrid(const state_array_t *sa){
+
+    return gridMakeStrided(sa->nrows, sa->ncols, sa->stride);
+}
+
+/** Return a reference to the sum plane: the sum of element i is getSumPlane()[i].*/
+value_t * getSumPlane(const state_array_t *sa){
+
+    return sa->sum_plane;
+}
+
+/** Return a reference to the sync plane, which holds the epoch of each element.*/
+state * getSyncPlane(const state_array_t *sa){
+
+    return sa->sync_plane;
 }
 
 /** Return the number of rows in the state array.*/
-int getNumRows(){
+int getNumRows(const state_array_t *sa){
 
-    return nrows;
+    return sa->nrows;
 }
 
 /** Return the number of columns in the state array.*/
-int getNumCols(){
+int getNumCols(const state_array_t *sa){
+
+    return sa->ncols;
+}
+
+/** Return the number of elements per row, including padding.*/
+int getRowStride(const state_array_t *sa){
+
+    return sa->stride;
+}
+
+
+/** Print the size of a plane and the pages it is on.*/
+static void describePlane(FILE *out, const char *name, const alloc_block *blk, size_t bytes){
+
+    fprintf(out, ", %s plane %.2f MB on %s pages", name, bytes / 1048576.0,
+            blk->ptr == NULL ? "caller's" : allocPagesName(blk->pages));
+}
 
-    return ncols;
+
+void describeStateArray(const state_array_t *sa, FILE *out){
+
+    fprintf(out, "state array: %d x %d, row stride %d (%d padding)", sa->nrows, sa->ncols,
+            sa->stride, sa->stride - sa->ncols);
+    describePlane(out, "sum", &sa->sum_block, (size_t) sa->arr_cap * sizeof(value_t));
+    describePlane(out, "sync", &sa->sync_block, (size_t) sa->arr_cap * sizeof(state));
+    fprintf(out, "\n");
 }
 
 
@@ -93,82 +383,90 @@ int getNumCols(){
 /** Destroy all mutex and condition variables in each element, and then free the memory used
  *  by the array.
  */
-void destroyStateArray(){
+void destroyStateArray(state_array_t *sa){
+
+    if(sa == NULL){
+        return;
+    }
 
-    for(int i=0; i < arr_len; i++){
+#ifdef STATE_SYNC_MUTEX
+    for(int i=0; i < sa->arr_cap; i++){
 
-        pthread_cond_destroy(&(state_arr[i].cv));
-        pthread_mutex_destroy(&(state_arr[i].lock));
+        pthread_cond_destroy(&(sa->sync_plane[i].cv));
+        pthread_mutex_destroy(&(sa->sync_plane[i].lock));
     }
+#endif
 
-    free(state_arr);
-    state_arr = NULL;
+    allocFree(&sa->sum_block);
+    allocFree(&sa->sync_block);
+    free(sa);
 }
 
 
-/** For each element, including border elements, set the sum field to 0.
+/** For each element, including border elements, set the sum field and the epoch to 0.
  */
-void resetStateArray(){
+void resetStateArray(state_array_t *sa){
 
-    for(int i=0; i < arr_len; i++){
+    memset(sa->sum_plane, 0, sa->arr_len * sizeof(value_t));
 
-        pthread_mutex_lock(&(state_arr[i].lock));   // probably not required, because the barrier
+#ifdef STATE_SYNC_MUTEX
+    for(int i=0; i < sa->arr_len; i++){
+
+        pthread_mutex_lock(&(sa->sync_plane[i].lock));  // probably not required, because the barrier
                                                     // prevents parallel execution,
-        state_arr[i].sum = 0;
-        pthread_mutex_unlock(&(state_arr[i].lock)); // but using the mutex makes this code more
-                                                    // portable
+        sa->sync_plane[i].epoch = 0;
+        pthread_mutex_unlock(&(sa->sync_plane[i].lock)); // but using the mutex makes this code more
+                                                     // portable
     }
+#else
+    // Nobody is waiting while the array is reset, and an atomic_int has the same
+    // representation as an int, so the epochs can be cleared the same way.
+    memset(sa->sync_plane, 0, sa->arr_len * sizeof(state));
+#endif
 
 }
 
-/** For each border element, set the sum field to 1 and signal on the elements condition
- *  variable. Border elements are found in the last column and in the bottom row of the
- *  array.
+/** For each border element, set the sum field to its value from the stencil (1 by
+ *  default, see stencil.h) and mark it ready for every round, waking any thread waiting on
+ *  it. Border elements are found in the last column and in the bottom row of the array.
  */
-void initBorders(){
+void initBorders(state_array_t *sa){
 
-    //TODO: Write me.
+    grid_t g = getGrid(sa);
+    int R = gridRows(g);
+    int C = gridCols(g);
 
-    // It's important to use the lock and cv fields here. You're not just
-    // setting the sum values of the border elements, you are triggering the
-    // wavefront.  Use pthread_cond_broadcast() rather than pthread_cond_signal().
-    //  ( is there a case where it could make a difference? )
-    // printf("%s\n", "Initiating Borders");
-    for (int i = 0; i <  nrows; i ++){
-      int b_idx = index(i, ncols-1);
-      // printf("Initializing border idx %d\n", b_idx);
-      pthread_mutex_lock(&state_arr[b_idx].lock);
-      state_arr[b_idx].sum = 1;
-      pthread_cond_broadcast(&state_arr[b_idx].cv);
-      pthread_mutex_unlock(&state_arr[b_idx].lock);
+    for (int i = 0; i <  R; i ++){
+      publishState(sa, gridIndex(g, i, C-1), stencilBorder(R-1-i, 0), BORDER_EPOCH);
     }
 
-    for (int i = 0; i <  ncols-1; i ++){
-      int b_idx = index(nrows-1, i);
-      // printf("Initializing border idx %d\n", b_idx);
-      pthread_mutex_lock(&state_arr[b_idx].lock);
-      state_arr[b_idx].sum = 1;
-      pthread_cond_broadcast(&state_arr[b_idx].cv);
-      pthread_mutex_unlock(&state_arr[b_idx].lock);
+    for (int i = 0; i <  C-1; i ++){
+      publishState(sa, gridIndex(g, R-1, i), stencilBorder(0, C-1-i), BORDER_EPOCH);
     }
 
 }
 
 
-void signalBorderCVs(int idx)
+static void signalElement(state_array_t *sa, int b_idx){
+
+#ifdef STATE_SYNC_MUTEX
+    pthread_mutex_lock(&sa->sync_plane[b_idx].lock);
+    pthread_cond_broadcast(&sa->sync_plane[b_idx].cv);
+    pthread_mutex_unlock(&sa->sync_plane[b_idx].lock);
+#else
+    futexWakeAll(&sa->sync_plane[b_idx].epoch);
+#endif
+}
+
+
+void signalBorderCVs(state_array_t *sa)
 {
-  for (int i=0; i <  nrows; i ++){
-    int b_idx = index(i, ncols-1);
-    pthread_mutex_lock(&state_arr[b_idx].lock);
-    pthread_cond_broadcast(&state_arr[b_idx].cv);
-    pthread_mutex_unlock(&state_arr[b_idx].lock);
+  for (int i=0; i <  sa->nrows; i ++){
+    signalElement(sa, index(sa, i, sa->ncols-1));
   }
 
-  for (int i=0; i <  ncols-1; i ++){
-    int b_idx = index(nrows-1, i);
-    pthread_mutex_lock(&state_arr[b_idx].lock);
-    pthread_cond_broadcast(&state_arr[b_idx].cv);
-    pthread_mutex_unlock(&state_arr[b_idx].lock);
+  for (int i=0; i <  sa->ncols-1; i ++){
+    signalElement(sa, index(sa, sa->nrows-1, i));
   }
 
   // printf("Exiting signal border idx %d\n", idx);
@@ -181,34 +479,34 @@ void signalBorderCVs(int idx)
  *  @param c the column coordinate
  *  @return the element index
 */
-int index(int r, int c){
+int index(const state_array_t *sa, int r, int c){
 
-    return  r * ncols + c;
+    return gridIndex(getGrid(sa), r, c);
 }
 
 /** Given the index of an element, return the index of the north neighbor.
  *  @param index the element index
  *  @return the neighbor index
  */
-int N(int index){
+int N(const state_array_t *sa, int index){
 
-	return index - ncols;
+	return gridN(getGrid(sa), index);
 }
 
 /** Given the index of an element, return the index of the south neighbor.
  *  @param index the element index
  *  @return the neighbor index
  */
-int S(int index){
+int S(const state_array_t *sa, int index){
 
-	return index + ncols;
+	return gridS(getGrid(sa), index);
 }
 
 /** Given the index of an element, return the index of the east neighbor.
  *  @param index the element index
  *  @return the neighbor index
  */
-int E(int index){
+int E(const state_array_t *sa, int index){
 
 	return index + 1;
 }
@@ -217,27 +515,74 @@ int E(int index){
  *  @param index the element index
  *  @return the neighbor index
  */
-int W(int index){
+int W(const state_array_t *sa, int index){
 
 	return index - 1;
 }
 
-/** Given the index of an element, wait on that element's condition variable until
- *  the element's sum field is non-zero, and then return the sum value.
+/** Given the index of an element, wait until the element is ready for the given epoch,
+ *  and then return the sum value.
+ *
+ *  In the mutex variant, this waits on the element's condition variable. Otherwise it
+ *  spins on the epoch for a while, and then announces itself in the epoch's waiter bit
+ *  and sleeps on it with a futex.
  *
  *  @param index the element index
+ *  @param epoch the epoch (round + 1) the caller needs
  *  @return the element's sum value.
  */
-int waitOnNeighbor(int index){
-
-    //TODO: Write me.
-    //
-    // putting this code in a function that is called by doWork() cleans
-    // up the doWork() code, but if you'd rather write this code directly
-    // in the thread function, that's okay too.
-    //
-    // In any case, remember to use a while loop with cond_wait(), so
-    // you don't have problems with missed signals, etc.
-
-	return 42;
+value_t waitOnNeighbor(state_array_t *sa, int index, int epoch){
+
+    state *st = &sa->sync_plane[index];
+
+#ifdef STATE_SYNC_MUTEX
+    pthread_mutex_lock(&st->lock);
+    while(st->epoch < epoch){
+        pthread_cond_wait(&st->cv, &st->lock);
+    }
+    value_t sum = sa->sum_plane[index];
+    pthread_mutex_unlock(&st->lock);
+
+    return sum;
+#else
+    epochWait(&st->epoch, epoch);
+
+    return sa->sum_plane[index];
+#endif
+}
+
+/** Return non-zero if the element is already ready for the given epoch, without waiting.*/
+int neighborReady(state_array_t *sa, int index, int epoch){
+
+#ifdef STATE_SYNC_MUTEX
+    pthread_mutex_lock(&sa->sync_plane[index].lock);
+    int ready = (sa->sync_plane[index].epoch >= epoch);
+    pthread_mutex_unlock(&sa->sync_plane[index].lock);
+
+    return ready;
+#else
+    return epochRead(&sa->sync_plane[index].epoch, memory_order_relaxed) >= epoch;
+#endif
+}
+
+/** Store the sum of an element for the given epoch, and wake any threads waiting on it.
+ *
+ *  @param index the element index
+ *  @param sum the new sum value
+ *  @param epoch the epoch (round + 1) the sum belongs to
+ */
+void publishState(state_array_t *sa, int index, value_t sum, int epoch){
+
+    state *st = &sa->sync_plane[index];
+
+#ifdef STATE_SYNC_MUTEX
+    pthread_mutex_lock(&st->lock);
+    sa->sum_plane[index] = sum;
+    st->epoch = epoch;
+    pthread_cond_broadcast(&st->cv);
+    pthread_mutex_unlock(&st->lock);
+#else
+    sa->sum_plane[index] = sum;
+    epochPublish(&st->epoch, epoch);
+#endif
 }
@@ -1,52 +1,174 @@
 #ifndef STATE_ARRAY_H
 #define STATE_ARRAY_H
 
-// A struct holding the sum value for a "state array" element,
-// including an associated mutex and condition variable.
+// Note: index() below clashes with the BSD index() in <strings.h>, which <string.h> also
+// declares when _GNU_SOURCE or _DEFAULT_SOURCE is defined. Files that include this header
+// should stick to the strict C11 / POSIX feature macros.
+
+#include <stdio.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "futex.h"
+#include "grid.h"
+#include "value.h"
+
+// The epoch of an element says which round its sum belongs to: an element is ready for
+// round r once its epoch is at least r + 1. Border elements never change, so they are
+// given an epoch that is ready for every round.
+#define BORDER_EPOCH 0x3fffffff
+
+// The sum and sync planes are aligned to this many bytes.
+#define CACHE_LINE 64
+
+#ifdef STATE_SYNC_MUTEX
+
+// The synchronization data for a "state array" element: an associated mutex and
+// condition variable guarding the element's epoch. The sum itself lives in the sum plane.
 typedef struct{
 
 	pthread_cond_t  cv;
 	pthread_mutex_t lock;
-	int sum;
+	int epoch;
+} state;
+
+#else
+
+// The synchronization data for a "state array" element. Readiness is published through
+// the atomic epoch with release/acquire ordering, and waiters spin briefly and then sleep
+// on the epoch with a futex (see epochWait() in futex.h). The sum itself lives in the sum
+// plane.
+typedef struct{
+
+	atomic_int epoch;
 } state;
 
+#endif
+
+// A handle to a state array. Every function below takes the handle of the array it works
+// on, so a process can hold several arrays at once.
+typedef struct state_array state_array_t;
+
 /** Allocate a new state array with the specified number of rows and columns. For
  *  each element, the "condition variable" and "mutex" data members are initialized, and
  *  the sum is set to 0.
  *
  *  @param _nrows number of rows in the new array
  *  @param _ncols number of columns in the new array
+ *  @return the new array, or NULL if it couldn't be allocated
+ */
+state_array_t * createStateArray(int _nrows, int _ncols);
+
+/** Allocate a new state array like createStateArray(), but initialize it from one thread
+ *  per NUMA node, each first-touching its own band of rows (see affinity.h). Workers
+ *  pinned with affinityCpu() in row order then find their rows on their own node.
+ *
+ *  @param _nrows number of rows in the new array
+ *  @param _ncols number of columns in the new array
+ */
+state_array_t * createStateArrayOnNodes(int _nrows, int _ncols);
+
+/** Allocate a new state array like createStateArray(), but keep the sums in the given
+ *  memory instead of a plane of its own, such as a mapped grid file (see grid_file.h).
+ *  The caller keeps ownership of that memory, which must hold _nrows * _ncols values and
+ *  outlive the array.
+ *
+ *  @param _nrows number of rows in the new array
+ *  @param _ncols number of columns in the new array
+ *  @param sums the memory for the sum plane
+ *  @return the new array, or NULL if it couldn't be allocated
+ */
+state_array_t * createStateArrayOver(int _nrows, int _ncols, value_t *sums);
+
+/** Reuse the existing state array for a new shape, if it has room for that many elements.
+ *  The sums and epochs of the elements in use are reset to 0; the mutexes and condition
+ *  variables are kept. Call initBorders() afterwards, as for a new array.
+ *
+ *  @param sa the array, or NULL
+ *  @param _nrows number of rows in the reshaped array
+ *  @param _ncols number of columns in the reshaped array
+ *  @return 0 on success, or -1 if there is no array or it is too small
  */
-void createStateArray(int _nrows, int _ncols);
+int reshapeStateArray(state_array_t *sa, int _nrows, int _ncols);
+
+/** Make the state array the specified shape: reshape the existing one if it is big
+ *  enough, and otherwise replace it with a new one, created with createStateArrayOnNodes()
+ *  if on_nodes is non-zero and with createStateArray() if not.
+ *
+ *  @param sa the array to reuse, or NULL
+ *  @param _nrows number of rows in the array
+ *  @param _ncols number of columns in the array
+ *  @param on_nodes non-zero to first-touch a new array from each NUMA node
+ *  @return sa, or the array that replaced it (sa is then destroyed)
+ */
+state_array_t * acquireStateArray(state_array_t *sa, int _nrows, int _ncols, int on_nodes);
 
 /** Destroy all mutex and condition variables in each element, and then free the memory used
- *  by the array.
+ *  by the array. Does nothing if sa is NULL.
  */
-void destroyStateArray();
+void destroyStateArray(state_array_t *sa);
 
 
 /** Return the number of rows in the state array.*/
-int getNumRows();
+int getNumRows(const state_array_t *sa);
 
 /** Return the number of columns in the state array.*/
-int getNumCols();
+int getNumCols(const state_array_t *sa);
+
+/** Return the number of elements per row, including padding (see allocRowStride()).*/
+int getRowStride(const state_array_t *sa);
+
+/** Print the shape, row stride, and allocation (size and page kind) of each plane of the
+ *  state array, for the stats output.
+ */
+void describeStateArray(const state_array_t *sa, FILE *out);
 
-/** Return a reference to the state array.*/
-state * getStateArray();
+/** Return the shape of the state array as a grid handle, for the index helpers in grid.h.*/
+grid_t getGrid(const state_array_t *sa);
 
-/** Set the sum field to 1 for all border elements. Border elements are found in the last column
- *  and in the bottom row of the array.
+/** Return a reference to the sum plane: the sum of element i is getSumPlane(sa)[i].*/
+value_t * getSumPlane(const state_array_t *sa);
+
+/** Return a reference to the sync plane, which holds the epoch of each element.*/
+state * getSyncPlane(const state_array_t *sa);
+
+/** Set the sum field of all border elements to their values in the stencil (1 by default,
+ *  see stencil.h), and mark them ready for every round.
+ *  Border elements are found in the last column and in the bottom row of the array.
  */
-void initBorders();
+void initBorders(state_array_t *sa);
 
-void signalBorderCVs();
+void signalBorderCVs(state_array_t *sa);
 
-/** For each element, including border elements, set the sum field to 0.
+/** For each element, including border elements, set the sum field and the epoch to 0.
+ *  This is only needed to start over from round 0 in the same array; between the rounds
+ *  of one run the epochs already tell the rounds apart.
  */
-void resetStateArray();
+void resetStateArray(state_array_t *sa);
+
 
+/** Given the index of an element, wait until the element is ready for the given epoch,
+ *  and then return the sum value.
+ *
+ *  @param index the element index
+ *  @param epoch the epoch (round + 1) the caller needs
+ *  @return the element's sum value.
+ */
+value_t waitOnNeighbor(state_array_t *sa, int index, int epoch);
+
+/** Return non-zero if the element is already ready for the given epoch, without waiting.*/
+int neighborReady(state_array_t *sa, int index, int epoch);
+
+/** Store the sum of an element for the given epoch, and wake any threads waiting on it.
+ *
+ *  @param index the element index
+ *  @param sum the new sum value
+ *  @param epoch the epoch (round + 1) the sum belongs to
+ */
+void publishState(state_array_t *sa, int index, value_t sum, int epoch);
 
-int waitOnNeighbor(int index);
+// The functions below read the shape of the state array on every call. Code that computes
+// many indices should get a handle once with getGrid() and use the grid.h helpers.
 
 /** Given a row and column, compute the index of the corresponding element of the state_array.
  *
@@ -54,32 +176,32 @@ int waitOnNeighbor(int index);
  *  @param c the column coordinate
  *  @return the element index
 */
-int index(int r, int c);
+int index(const state_array_t *sa, int r, int c);
 
 
 /** Given the index of an element, return the index of the north neighbor.
  *  @param index the element index
  *  @return the neighbor index
  */
-int N(int index);
+int N(const state_array_t *sa, int index);
 
 /** Given the index of an element, return the index of the south neighbor.
  *  @param index the element index
  *  @return the neighbor index
  */
-int S(int index);
+int S(const state_array_t *sa, int index);
 
 /** Given the index of an element, return the index of the east neighbor.
  *  @param index the element index
  *  @return the neighbor index
  */
-int E(int index);
+int E(const state_array_t *sa, int index);
 
 /** Given the index of an element, return the index of the west neighbor.
  *  @param index the element index
  *  @return the neighbor index
  */
-int W(int index);
+int W(const state_array_t *sa, int index);
 
 
 #endif
@@ -0,0 +1,184 @@
+#ifndef STENCIL_H
+#define STENCIL_H
+
+/*
+ * stencil.h
+ *
+ * The recurrence the engines compute. Every interior element depends on its east, south,
+ * and south-east neighbors, and the border elements (the last column and the bottom row)
+ * are given, whatever the workload; only how the three neighbors are combined, and what
+ * the borders hold, depend on it. The workload is chosen at compile time, like the value
+ * type, so that every kernel inlines it:
+ *
+ *      (default)           delannoy: E + S + SE, with all-ones borders
+ *      -DSTENCIL_LCS       lcs: the length of the longest common subsequence
+ *      -DSTENCIL_EDIT      edit: the edit (Levenshtein) distance
+ *      -DSTENCIL_LOCAL     local: Smith-Waterman scores (+2 for a match, -1 for a mismatch
+ *                          or a gap), floored at 0
+ *      -DSTENCIL_MINPATH   minpath: the cheapest path, stepping south, east, or south-east,
+ *                          from an element to the border, through elements that cost 1-8
+ *
+ * Positions are (r, c), counted from the south-east corner: the element at (row, col) of
+ * an nrows x ncols array is at r = nrows-1-row, c = ncols-1-col, and the border elements
+ * are the ones with r == 0 or c == 0. Stencils only depend on positions counted this way,
+ * so element (row, col) of a larger array is element 0 of the (nrows-row) x (ncols-col)
+ * array, which batches, grid files, and the cache rely on.
+ *
+ * The sequence workloads compare two synthetic sequences over a 4-letter alphabet made up
+ * from the positions (see stencilSymbol()), so runs need no input: element (r, c) compares
+ * symbols 1 through r of sequence A with symbols 1 through c of sequence B.
+ *
+ * Only the delannoy stencil grows fast enough to wrap around. The others stay below
+ * 8 * (nrows + ncols), so they use plain arithmetic and give the same results with every
+ * value type. The closed engine only exists for the delannoy stencil (STENCIL_DELANNOY).
+ *
+ * Each stencil defines STENCIL_NAME and two functions:
+ *
+ *      value_t stencilCombine(value_t e, value_t s, value_t se, int r, int c)
+ *          the sum of interior element (r, c), from the sums of its east, south, and
+ *          south-east neighbors
+ *      value_t stencilBorder(int r, int c)
+ *          the sum of border element (r, c)
+ */
+#include <stdint.h>
+
+#include "value.h"
+
+// The CUDA engine runs the stencil on the device as well.
+#ifdef __CUDACC__
+#define STENCIL_FN __host__ __device__ static inline
+#else
+#define STENCIL_FN static inline
+#endif
+
+
+/** Return symbol i of sequence seq (0 for A, 1 for B), one of 0 .. 3.*/
+STENCIL_FN int stencilSymbol(int i, int seq){
+
+    uint32_t x = ((uint32_t) i + (uint32_t) seq * 0x9e3779b9u) * 0x85ebca6bu;
+    x ^= x >> 13;
+    x *= 0xc2b2ae35u;
+    return (int)(x >> 30);
+}
+
+/** Return 1 if symbol r of sequence A is symbol c of sequence B, and 0 otherwise.*/
+STENCIL_FN int stencilMatch(int r, int c){
+
+    return stencilSymbol(r, 0) == stencilSymbol(c, 1);
+}
+
+STENCIL_FN value_t stencilMin(value_t a, value_t b){
+
+    return a < b ? a : b;
+}
+
+STENCIL_FN value_t stencilMax(value_t a, value_t b){
+
+    return a > b ? a : b;
+}
+
+
+#if defined(STENCIL_LCS)
+
+#define STENCIL_NAME "lcs"
+
+STENCIL_FN value_t stencilCombine(value_t e, value_t s, value_t se, int r, int c){
+
+    value_t skip = stencilMax(e, s);
+    return stencilMatch(r, c) ? se + 1 : skip;
+}
+
+STENCIL_FN value_t stencilBorder(int r, int c){
+
+    (void) r;
+    (void) c;
+    return 0;
+}
+
+#elif defined(STENCIL_EDIT)
+
+#define STENCIL_NAME "edit"
+
+STENCIL_FN value_t stencilCombine(value_t e, value_t s, value_t se, int r, int c){
+
+    value_t gap = stencilMin(e, s) + 1;
+    return stencilMin(gap, se + (value_t)(1 - stencilMatch(r, c)));
+}
+
+// One of r and c is 0, and the other is the number of symbols left to delete.
+STENCIL_FN value_t stencilBorder(int r, int c){
+
+    return (value_t)(r + c);
+}
+
+#elif defined(STENCIL_LOCAL)
+
+#define STENCIL_NAME "local"
+
+/** Return max(x - 1, 0), without going below 0 in the unsigned value types.*/
+STENCIL_FN value_t stencilDecrement(value_t x){
+
+    return x > 0 ? x - 1 : 0;
+}
+
+STENCIL_FN value_t stencilCombine(value_t e, value_t s, value_t se, int r, int c){
+
+    value_t diag = stencilMatch(r, c) ? se + 2 : stencilDecrement(se);
+    return stencilMax(diag, stencilDecrement(stencilMax(e, s)));
+}
+
+STENCIL_FN value_t stencilBorder(int r, int c){
+
+    (void) r;
+    (void) c;
+    return 0;
+}
+
+#elif defined(STENCIL_MINPATH)
+
+#define STENCIL_NAME "minpath"
+
+/** Return the cost of stepping onto element (r, c), 1 .. 8.*/
+STENCIL_FN value_t stencilCost(int r, int c){
+
+    uint32_t x = (uint32_t) r * 0x9e3779b1u ^ (uint32_t) c * 0x85ebca77u;
+    x ^= x >> 15;
+    x *= 0xc2b2ae3du;
+    return (value_t)(1 + (x >> 29));
+}
+
+STENCIL_FN value_t stencilCombine(value_t e, value_t s, value_t se, int r, int c){
+
+    return stencilCost(r, c) + stencilMin(stencilMin(e, s), se);
+}
+
+STENCIL_FN value_t stencilBorder(int r, int c){
+
+    (void) r;
+    (void) c;
+    return 0;
+}
+
+#else
+
+#define STENCIL_DELANNOY
+#define STENCIL_NAME "delannoy"
+
+STENCIL_FN value_t stencilCombine(value_t e, value_t s, value_t se, int r, int c){
+
+    (void) r;
+    (void) c;
+    return valueAdd3(e, s, se);
+}
+
+STENCIL_FN value_t stencilBorder(int r, int c){
+
+    (void) r;
+    (void) c;
+    return VALUE_ONE;
+}
+
+#endif
+
+
+#endif
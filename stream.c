@@ -0,0 +1,85 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "stream.h"
+#include "value.h"
+#include "stencil.h"
+#include "report.h"
+
+/** The streaming engine always runs along the shorter dimension: it walks "rows" of
+ *  length width = min(nrows, ncols), starting at the south border, for
+ *  height = max(nrows, ncols) rows. When the array has fewer rows than columns, the rows it
+ *  walks are the columns of the array, so the east and south neighbors (and the
+ *  coordinates the stencil gets) trade places. The default stencil is the same function of
+ *  both, so for it the two sweeps are alike.
+ *
+ *  With r and c counted from the south-east corner, each row is computed from the previous
+ *  one as
+ *
+ *      cur[c] = cur[c-1] + prev[c] + prev[c-1]
+ *
+ *  where cur[c-1] is the east neighbor, prev[c] the south, and prev[c-1] the south-east.
+ *  The first row, and the first element of each row, are border elements.
+ */
+
+
+
+/** Sweep height rows of width elements, and return the last element. transposed is a
+ *  constant in each call, so each direction gets its own loop.
+ */
+static inline value_t sweepRows(int width, int height, value_t *rows, const int transposed){
+
+    value_t *prev = rows;
+    value_t *cur = rows + width;
+
+    for(int c=0; c < width; c++){
+        prev[c] = transposed ? stencilBorder(c, 0) : stencilBorder(0, c);
+    }
+
+    for(int r=1; r < height; r++){
+
+        cur[0] = transposed ? stencilBorder(0, r) : stencilBorder(r, 0);
+        for(int c=1; c < width; c++){
+            cur[c] = transposed ? stencilCombine(prev[c], cur[c - 1], prev[c - 1], c, r)
+                                : stencilCombine(cur[c - 1], prev[c], prev[c - 1], r, c);
+        }
+
+        value_t *t = prev;
+        prev = cur;
+        cur = t;
+    }
+
+    return prev[width - 1];
+}
+
+
+value_t streamSweep(int num_state_rows, int num_state_cols, value_t *rows){
+
+    if(num_state_rows < num_state_cols){
+        return sweepRows(num_state_rows, num_state_cols, rows, 1);
+    }
+
+    return sweepRows(num_state_cols, num_state_rows, rows, 0);
+}
+
+
+int streamWavefront(int num_state_rows, int num_state_cols, int numRounds, const engine_opts *opts){
+
+    int width = (num_state_rows < num_state_cols) ? num_state_rows : num_state_cols;
+
+    value_t *rows = malloc(2 * (size_t) width * sizeof(value_t));
+    if(rows == NULL){
+        return EXIT_FAILURE;
+    }
+
+    for(int round=0; round < numRounds; round++){
+
+        value_t result = streamSweep(num_state_rows, num_state_cols, rows);
+
+        reportRound(round, result);
+    }
+
+    free(rows);
+
+    return EXIT_SUCCESS;
+}
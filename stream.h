@@ -0,0 +1,26 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include "value.h"
+#include "wavefront.h"
+
+/** Run the wavefront computation serially, one row at a time from the south border up,
+ *  keeping only the current and previous rows. Memory use is O(min(rows, cols)), so grids
+ *  with millions of columns fit easily.
+ *
+ *  This engine doesn't use the state array, and only element 0 is computed in full. See
+ *  wavefront() for the parameters.
+ */
+int streamWavefront(int num_state_rows, int num_state_cols, int numRounds, const engine_opts *opts);
+
+/** Compute the result (element 0) of a single round, one row at a time.
+ *
+ *  @param num_state_rows number of rows in the state array
+ *  @param num_state_cols number of columns in the state array
+ *  @param rows scratch space for 2 * min(num_state_rows, num_state_cols) values
+ *  @return the sum of element 0
+ */
+value_t streamSweep(int num_state_rows, int num_state_cols, value_t *rows);
+
+
+#endif
@@ -0,0 +1,482 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "barrier.h"
+#include "state_array.h"
+#include "tiled.h"
+#include "value.h"
+#include "stencil.h"
+#include "report.h"
+#include "wspool.h"
+#include "affinity.h"
+
+/** This file implements the tiled wavefront engine. Rather than creating one thread per
+ *  interior element, the interior of the state array is split into tiles of
+ *  tile_rows x tile_cols elements, and a fixed pool of workers computes whole tiles.
+ *
+ *  Dependencies are tracked per tile rather than per element: a tile may be computed once
+ *  its east, south, and south-east neighbor tiles are done. Tiles on the east and south
+ *  edges of the interior depend on the border elements instead, which are always valid.
+ *
+ *  Scheduling uses the work-stealing pool in wspool.c. Each tile has an atomic count of
+ *  the dependencies it is still waiting for. When a worker finishes a tile, it decrements
+ *  the counts of the north, west, and north-west tiles, and pushes each tile whose count
+ *  reaches zero onto its own deque. Idle workers steal from the other deques, so the short
+ *  anti-diagonals near the corners don't leave cores waiting on a static assignment.
+ *
+ *  The workers outlive a single computation. tiledCreate() starts them, along with a tile
+ *  array sized for the largest expected grid, and they then wait at the barrier for
+ *  tiledRun() to hand them a job on a state array supplied by the caller. Each job may
+ *  have a different shape: the arrays are reused when they are big enough, and grown
+ *  otherwise. All of the engine's state is in its tiled_engine, so several engines (each
+ *  with its own workers, barrier and state array) can run side by side.
+ */
+
+
+
+// A tile of interior elements and its dependency count.
+typedef struct{
+
+    atomic_int deps;        // dependencies not yet done in the current round
+    int num_deps;           // dependencies this tile has in every round
+
+    int r0, c0;             // north-west element of the tile (inclusive)
+    int r1, c1;             // south-east bound of the tile (exclusive)
+} tile;
+
+
+
+// A tiled engine: its tiles, its pool and the threads working on it, and the job they run.
+struct tiled_engine{
+
+    tile * tiles;               // tiles in row-major order
+    int tile_cap;               // number of entries allocated in tiles
+    int num_tile_rows, num_tile_cols, num_tiles;
+    int tile_rows, tile_cols;   // elements per tile
+
+    wspool * pool;
+    int rounds_left;            // rounds of the job not yet started
+    state_array_t * sa;         // the state array of the job
+    value_t result;             // element 0 of the last completed round
+
+    int num_threads;
+    int stats;
+
+    // The job the workers run after the next barrier: a number of rounds, or quit.
+    int job_rounds;
+    int quit;
+
+    barrier_t barrier;
+    gate_t gate;                // holds the workers back until all of them are created
+    pthread_t * thread_arr;
+    struct worker_args * args;
+};
+
+
+// A struct for passing arguments to a worker thread.
+typedef struct worker_args{
+
+    tiled_engine *eng;
+    int worker;
+    int cpu;                // the CPU to pin this worker to, or -1 to leave it unpinned
+} worker_args;
+
+
+
+static void * tiledWorker(void * a);
+static void * tiledBarrierFunction(void * a);
+static void runTile(wspool *pool, int worker, int t_idx, void *ctx);
+static void startRound(tiled_engine *eng);
+
+
+
+/** Return the number of tiles needed to cover the interior of a state array.*/
+static int countTiles(const tiled_engine *eng, int num_state_rows, int num_state_cols){
+
+    int interior_rows = num_state_rows - 1;
+    int interior_cols = num_state_cols - 1;
+
+    return ((interior_rows + eng->tile_rows - 1) / eng->tile_rows)
+         * ((interior_cols + eng->tile_cols - 1) / eng->tile_cols);
+}
+
+
+/** Free an engine whose workers have exited (or were never started), apart from its
+ *  barrier and gate.
+ */
+static void freeEngine(tiled_engine *eng){
+
+    if(eng->pool != NULL){
+        wspoolDestroy(eng->pool);
+    }
+    free(eng->thread_arr);
+    free(eng->args);
+    free(eng->tiles);
+    free(eng);
+}
+
+
+tiled_engine * tiledCreate(int max_state_rows, int max_state_cols, const engine_opts *opts,
+                           int first_slot, int num_slots){
+
+    tiled_engine *eng = calloc(1, sizeof(tiled_engine));
+    if(eng == NULL){
+        return NULL;
+    }
+
+    eng->tile_rows = opts->tile_rows > 0 ? opts->tile_rows : DEFAULT_TILE_SIZE;
+    eng->tile_cols = opts->tile_cols > 0 ? opts->tile_cols : eng->tile_rows;
+    eng->stats = opts->stats;
+
+    int max_tiles = countTiles(eng, max_state_rows, max_state_cols);
+
+    int num_threads = opts->num_threads;
+    if(num_threads <= 0){
+        num_threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    if(num_threads > max_tiles){
+        num_threads = max_tiles;
+    }
+    if(num_threads < 1){
+        num_threads = 1;
+    }
+    eng->num_threads = num_threads;
+
+    if(num_slots <= 0){
+        first_slot = 0;
+        num_slots = num_threads;
+    }
+
+    eng->tile_cap = max_tiles > 0 ? max_tiles : 1;
+    eng->tiles = malloc(eng->tile_cap * sizeof(tile));
+    eng->num_tiles = 0;
+
+    eng->pool = wspoolCreate(num_threads, eng->tile_cap, runTile, eng);
+    eng->thread_arr = malloc(num_threads * sizeof(pthread_t));
+    eng->args = malloc(num_threads * sizeof(worker_args));
+
+    if(eng->tiles == NULL || eng->pool == NULL || eng->thread_arr == NULL || eng->args == NULL
+       || gate_init(&eng->gate) != 0){
+        freeEngine(eng);
+        return NULL;
+    }
+
+    // The main thread joins the workers at the barrier, both to hand them each job and to
+    // print the result of each round.
+    if(barrier_init_kind(&eng->barrier, num_threads + 1, tiledBarrierFunction,
+                         opts->barrier) != 0){
+        gate_destroy(&eng->gate);
+        freeEngine(eng);
+        return NULL;
+    }
+
+    if(opts->affinity && num_slots == num_threads){
+        affinityReport(stderr, num_threads, max_state_rows);
+    }
+
+    int started = 0;
+    for(; started < num_threads; started++){
+
+        worker_args *args = &eng->args[started];
+        args->eng = eng;
+        args->worker = started;
+        args->cpu = opts->affinity ? affinityCpu(first_slot + started, num_slots) : -1;
+
+        if(pthread_create(&eng->thread_arr[started], NULL, tiledWorker, args) != 0){
+            break;
+        }
+    }
+
+    // The barrier counts every worker, so if one couldn't be created, the others are sent
+    // home from the gate instead.
+    gate_open(&eng->gate, started == num_threads);
+
+    if(started < num_threads){
+
+        for(int i=0; i < started; i++){
+            pthread_join(eng->thread_arr[i], NULL);
+        }
+        barrier_destroy(&eng->barrier);
+        gate_destroy(&eng->gate);
+        freeEngine(eng);
+        return NULL;
+    }
+
+    return eng;
+}
+
+
+/** Split the interior of the state array into tiles of tile_rows x tile_cols elements,
+ *  growing the tile array if needed.
+ *  @return 0 on success, or -1 if the memory couldn't be allocated
+ */
+static int makeTiles(tiled_engine *eng, int num_state_rows, int num_state_cols){
+
+    int interior_rows = num_state_rows - 1;
+    int interior_cols = num_state_cols - 1;
+
+    eng->num_tile_rows = (interior_rows + eng->tile_rows - 1) / eng->tile_rows;
+    eng->num_tile_cols = (interior_cols + eng->tile_cols - 1) / eng->tile_cols;
+    eng->num_tiles = eng->num_tile_rows * eng->num_tile_cols;
+
+    if(eng->num_tiles > eng->tile_cap){
+
+        tile *grown = realloc(eng->tiles, eng->num_tiles * sizeof(tile));
+        if(grown == NULL || wspoolReserve(eng->pool, eng->num_tiles) != 0){
+            return -1;
+        }
+        eng->tiles = grown;
+        eng->tile_cap = eng->num_tiles;
+    }
+
+    for(int ti=0; ti < eng->num_tile_rows; ti++){
+        for(int tj=0; tj < eng->num_tile_cols; tj++){
+
+            tile *t = &eng->tiles[ti * eng->num_tile_cols + tj];
+
+            t->num_deps = (tj + 1 < eng->num_tile_cols)
+                        + (ti + 1 < eng->num_tile_rows)
+                        + (ti + 1 < eng->num_tile_rows && tj + 1 < eng->num_tile_cols);
+            atomic_init(&t->deps, t->num_deps);
+
+            t->r0 = ti * eng->tile_rows;
+            t->c0 = tj * eng->tile_cols;
+            t->r1 = (t->r0 + eng->tile_rows < interior_rows) ? t->r0 + eng->tile_rows
+                                                             : interior_rows;
+            t->c1 = (t->c0 + eng->tile_cols < interior_cols) ? t->c0 + eng->tile_cols
+                                                             : interior_cols;
+        }
+    }
+
+    return 0;
+}
+
+
+int tiledRun(tiled_engine *eng, state_array_t **sa, int num_state_rows, int num_state_cols,
+             int numRounds, tiled_round_fn fn, void *fn_ctx){
+
+    // The workers are all waiting at the barrier, so the tiles, the pool, and the state
+    // array can be changed freely here. Both only grow: a smaller query reuses them.
+    if(makeTiles(eng, num_state_rows, num_state_cols) != 0){
+        return EXIT_FAILURE;
+    }
+
+    *sa = acquireStateArray(*sa, num_state_rows, num_state_cols, 0);
+    if(*sa == NULL){
+        return EXIT_FAILURE;
+    }
+    eng->sa = *sa;
+    initBorders(eng->sa);
+
+    eng->job_rounds = numRounds;
+    eng->rounds_left = numRounds;
+
+    // The first barrier hands the job to the workers, and starts the first round.
+    barrier_wait_id(&eng->barrier, eng->num_threads, eng);
+
+    for(int round=0; round < numRounds; round++){
+
+        barrier_wait_id(&eng->barrier, eng->num_threads, eng);
+
+        if(fn != NULL){
+            fn(fn_ctx, round, eng->result);
+        } else {
+            reportRound(round, eng->result);
+        }
+    }
+
+    // The caller may free or replace the array now. The workers won't be past the next
+    // barrier until this thread reaches it too, so nothing reads the array after this.
+    eng->sa = NULL;
+
+    return EXIT_SUCCESS;
+}
+
+
+int tiledDestroy(tiled_engine *eng){
+
+    if(eng == NULL){
+        return EXIT_SUCCESS;
+    }
+
+    eng->quit = 1;
+    barrier_wait_id(&eng->barrier, eng->num_threads, eng);
+
+    for(int i=0; i < eng->num_threads; i++){
+
+        if(pthread_join(eng->thread_arr[i], NULL) != 0){
+            return EXIT_FAILURE;
+        }
+    }
+
+    if(eng->stats){
+        wspoolPrintStats(eng->pool, stderr);
+    }
+
+    int status = barrier_destroy(&eng->barrier) != 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+    gate_destroy(&eng->gate);
+    freeEngine(eng);
+
+    return status;
+}
+
+
+int tiledWavefront(int num_state_rows, int num_state_cols, int numRounds, const engine_opts *opts){
+
+    tiled_engine *eng = tiledCreate(num_state_rows, num_state_cols, opts, 0, 0);
+    if(eng == NULL){
+        return EXIT_FAILURE;
+    }
+
+    state_array_t *sa = NULL;
+    if(opts->affinity){
+        sa = createStateArrayOnNodes(num_state_rows, num_state_cols);
+    }
+    int status = tiledRun(eng, &sa, num_state_rows, num_state_cols, numRounds, NULL, NULL);
+
+    if(tiledDestroy(eng) != 0){
+        return EXIT_FAILURE;
+    }
+    destroyStateArray(sa);
+
+    return status;
+}
+
+
+
+/** Compute every element of a tile, sweeping from its south-east corner. The east, south,
+ *  and south-east neighbor tiles must already be done for this round, so no locking is
+ *  needed on the elements themselves.
+ */
+static void computeTile(state_array_t *sa, const tile *t){
+
+    value_t *sum = getSumPlane(sa);
+    grid_t g = getGrid(sa);
+    int last_row = gridRows(g) - 1;
+    int last_col = gridCols(g) - 1;
+
+    for(int r=t->r1-1; r >= t->r0; r--){
+
+        value_t *row = &sum[gridIndex(g, r, 0)];
+        const value_t *south = &sum[gridIndex(g, r + 1, 0)];
+
+        for(int c=t->c1-1; c >= t->c0; c--){
+            row[c] = stencilCombine(row[c + 1], south[c], south[c + 1], last_row - r,
+                                    last_col - c);
+        }
+    }
+}
+
+
+/** Record that one dependency of the tile at (ti, tj) is done, and push the tile onto the
+ *  worker's deque if that was the last one. The count is put back to its initial value as
+ *  the tile is pushed, because nothing decrements it again until the next round.
+ */
+static void releaseTile(tiled_engine *eng, int worker, int ti, int tj){
+
+    if(ti < 0 || tj < 0){
+        return;
+    }
+
+    int t_idx = ti * eng->num_tile_cols + tj;
+    tile *t = &eng->tiles[t_idx];
+
+    if(atomic_fetch_sub_explicit(&t->deps, 1, memory_order_acq_rel) == 1){
+
+        atomic_store_explicit(&t->deps, t->num_deps, memory_order_relaxed);
+        wspoolPush(eng->pool, worker, t_idx);
+    }
+}
+
+
+/** The task function run by the pool: compute one tile and release its dependents. The
+ *  context pointer is the engine.
+ */
+static void runTile(wspool *pool, int worker, int t_idx, void *ctx){
+
+    tiled_engine *eng = (tiled_engine *) ctx;
+
+    int ti = t_idx / eng->num_tile_cols;
+    int tj = t_idx % eng->num_tile_cols;
+
+    computeTile(eng->sa, &eng->tiles[t_idx]);
+
+    releaseTile(eng, worker, ti - 1, tj - 1);
+    releaseTile(eng, worker, ti, tj - 1);
+    releaseTile(eng, worker, ti - 1, tj);
+}
+
+
+/** Announce the tiles of the next round to the pool, and seed it with the south-east tile,
+ *  which is the only one that doesn't depend on another tile.
+ */
+static void startRound(tiled_engine *eng){
+
+    if(eng->rounds_left == 0 || eng->num_tiles == 0){
+        return;
+    }
+
+    eng->rounds_left--;
+    wspoolBegin(eng->pool, eng->num_tiles);
+    wspoolPush(eng->pool, 0, eng->num_tiles - 1);
+}
+
+
+/** The worker thread function. Once every worker is created, the worker waits at the
+ *  barrier for a job. In each round
+ *  of the job, it runs tiles from the pool until every tile of the round is done, and then
+ *  waits at the barrier again. The worker exits when the job is to quit.
+ */
+static void * tiledWorker(void * a){
+
+    worker_args *args = (worker_args *) a;
+    tiled_engine *eng = args->eng;
+
+    if(!gate_wait(&eng->gate)){
+        return NULL;
+    }
+
+    if(args->cpu >= 0){
+        affinityPin(args->cpu);
+    }
+
+    for(;;){
+
+        barrier_wait_id(&eng->barrier, args->worker, eng);
+        if(eng->quit){
+            break;
+        }
+
+        int numRounds = eng->job_rounds;
+        for(int round=0; round < numRounds; round++){
+
+            wspoolRun(eng->pool, args->worker);
+            barrier_wait_id(&eng->barrier, args->worker, eng);
+        }
+    }
+
+    return NULL;
+}
+
+
+/** Executed by the last thread into the barrier, under the barrier mutex, with the engine
+ *  as its argument. Records the result of the round (if one was running) and starts the
+ *  next one. The state array doesn't need to be reset, since the tile dependencies (not
+ *  the sums) decide when an element is ready.
+ */
+static void * tiledBarrierFunction(void * a){
+
+    tiled_engine *eng = (tiled_engine *) a;
+
+    if(eng->sa != NULL){
+        eng->result = getSumPlane(eng->sa)[0];
+    }
+    startRound(eng);
+
+    return NULL;
+}
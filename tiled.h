@@ -0,0 +1,69 @@
+#ifndef TILED_H
+#define TILED_H
+
+#include "wavefront.h"
+
+/** Run the wavefront computation on a fixed pool of worker threads. The interior of the
+ *  state array is split into rectangular tiles, and each tile is computed serially by
+ *  whichever worker claims it. Tiles are handed out in anti-diagonal order, starting from
+ *  the south-east corner, and a tile may only be computed once its east, south, and
+ *  south-east neighbor tiles are done.
+ *
+ *  @param num_state_rows number of rows in the state array
+ *  @param num_state_cols number of columns in the state array
+ *  @param numRounds number of rounds to repeat
+ *  @param opts the engine options (thread count and tile size)
+ *  @return 0 on success, or an error code
+ */
+int tiledWavefront(int num_state_rows, int num_state_cols, int numRounds, const engine_opts *opts);
+
+// A tiled engine: a pool of worker threads with its own tiles and barrier. Engines are
+// independent, so several can run at once, each on its own state array.
+typedef struct tiled_engine tiled_engine;
+
+// Called by tiledRun() with the result of each round, instead of reportRound().
+typedef void (* tiled_round_fn)(void *ctx, int round, value_t result);
+
+/** Start a tiled engine, sized for grids of up to max_state_rows x max_state_cols. Its
+ *  workers wait for tiledRun() until tiledDestroy() is called.
+ *
+ *  With the affinity option, worker i is pinned to affinityCpu(first_slot + i, num_slots),
+ *  so engines that split the machine between them can each take a share of the CPUs.
+ *  Pass num_slots = 0 to number the workers from 0 over the engine's own threads.
+ *
+ *  @param max_state_rows number of rows in the largest expected state array
+ *  @param max_state_cols number of columns in the largest expected state array
+ *  @param opts the engine options (thread count, tile size, barrier, and affinity)
+ *  @param first_slot the placement number of the engine's first worker
+ *  @param num_slots the number of placement slots shared by all engines, or 0
+ *  @return the new engine, or NULL on failure
+ */
+tiled_engine * tiledCreate(int max_state_rows, int max_state_cols, const engine_opts *opts,
+                           int first_slot, int num_slots);
+
+/** Run a wavefront computation on an engine. The array in *sa is reused if it is big
+ *  enough, and replaced otherwise (see acquireStateArray()), so *sa holds the array of
+ *  this computation on return. The result of each round is passed to fn, or printed with
+ *  reportRound() if fn is NULL.
+ *
+ *  @param eng the engine
+ *  @param sa the state array to reuse, or a pointer to NULL
+ *  @param num_state_rows number of rows in the state array
+ *  @param num_state_cols number of columns in the state array
+ *  @param numRounds number of rounds to repeat
+ *  @param fn the function that receives each result, or NULL
+ *  @param fn_ctx passed to fn
+ *  @return 0 on success, or an error code
+ */
+int tiledRun(tiled_engine *eng, state_array_t **sa, int num_state_rows, int num_state_cols,
+             int numRounds, tiled_round_fn fn, void *fn_ctx);
+
+/** Stop the workers of an engine and free it. With the stats option, the scheduler
+ *  counters of all of its runs are printed to stderr.
+ *
+ *  @return 0 on success, or an error code
+ */
+int tiledDestroy(tiled_engine *eng);
+
+
+#endif
@@ -0,0 +1,736 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "tune.h"
+#include "wavefront.h"
+#include "closed.h"
+#include "recursive.h"
+#include "simd.h"
+#include "stream.h"
+#include "tiled.h"
+#include "state_array.h"
+#include "report.h"
+#include "value.h"
+#include "stencil.h"
+#include "grid.h"
+
+/** The profile file is one "key value" pair per line. The first five lines say what the
+ *  profile was measured on, and a profile is only used on a host where all five match:
+ *
+ *      a3-tune 1
+ *      host <hostname>
+ *      value <valueTypeName()>
+ *      build <the vector instructions, state array synchronization, and stencil built for>
+ *      cpus <online CPUs>
+ *
+ *  The measurements follow, one per line (see profileFields()). Rates are in elements per
+ *  second and times in seconds.
+ */
+
+
+
+#define TUNE_MAGIC "a3-tune"
+#define TUNE_VERSION 1
+
+// The calibration runs each engine on TUNE_GRID x TUNE_GRID elements (and the cell engine
+// on TUNE_CELL_GRID x TUNE_CELL_GRID), once for one round and once for TUNE_ROUNDS rounds.
+// The difference is the time of the extra rounds, and the rest of the first run is the
+// startup of the engine. Timestamps of single rounds can't be used: on a busy (or single)
+// CPU, the thread that reports a round may not run until the workers are done with the
+// next one.
+#define TUNE_ROUNDS 8
+
+// Each run is repeated this many times, and the fastest is kept.
+#define TUNE_REPEATS 3
+#define TUNE_GRID 512
+#define TUNE_CELL_GRID 17
+
+// The number of measurements in a profile.
+#define TUNE_MAX_FIELDS (TUNE_NUM_TILES + 8)
+
+// The closed form is timed on this many queries of TUNE_CLOSED_SIZE x TUNE_CLOSED_SIZE.
+#define TUNE_CLOSED_REPS 8
+#define TUNE_CLOSED_SIZE 4096
+
+// The build settings that change the measurements: the vector instructions of the
+// diagonal kernel, the synchronization of the state array, and the stencil (named only if
+// it isn't the default one).
+#if defined(__AVX512F__)
+#define TUNE_BUILD_SIMD "avx512"
+#elif defined(__AVX2__)
+#define TUNE_BUILD_SIMD "avx2"
+#elif defined(__ARM_NEON)
+#define TUNE_BUILD_SIMD "neon"
+#else
+#define TUNE_BUILD_SIMD "scalar"
+#endif
+
+#ifdef STATE_SYNC_MUTEX
+#define TUNE_BUILD_SYNC "-mutex"
+#else
+#define TUNE_BUILD_SYNC ""
+#endif
+
+#ifdef STENCIL_DELANNOY
+#define TUNE_BUILD TUNE_BUILD_SIMD TUNE_BUILD_SYNC
+#else
+#define TUNE_BUILD TUNE_BUILD_SIMD TUNE_BUILD_SYNC "-" STENCIL_NAME
+#endif
+
+
+// The measurements of a host.
+typedef struct{
+
+    int cpus;
+    double simd_rate;                       // the simd engine
+    double stream_rate;                     // the stream engine
+    double tiled_rate[TUNE_NUM_TILES];      // the tiled engine on one worker, per tile size
+    double recursive_rate;                  // the recursive engine on one worker
+    double pool_sec;                        // the startup of a pool engine, per worker
+    double cell_spawn_sec;                  // the cell engine, per element and query
+    double cell_round_sec;                  // the cell engine, per element and round
+    double closed_sec;                      // the closed form, per term
+} tune_profile;
+
+// A measurement, by name, for reading and writing the profile file.
+typedef struct{
+
+    const char *name;
+    double *value;
+} tune_field;
+
+
+// These variables have "static" scope. There is one profile per process, loaded by the
+// first query that needs it.
+static tune_profile profile;
+static int have_profile = 0;
+static int tune_set_up = 0;             // tuneLoad() was called
+static int tried_file = 0;              // the profile file was read (whether or not it was usable)
+static int tried_calibration = 0;       // the calibration was run (whether or not it succeeded)
+static char tune_path[1024];
+static int tune_explain = 0;
+
+static const int tune_tiles[TUNE_NUM_TILES] = TUNE_TILES;
+
+
+
+/** Fill in the measurements of the profile, by name.
+ *  @return the number of fields
+ */
+static int profileFields(tune_field *f){
+
+    static char names[TUNE_NUM_TILES][32];
+    int n = 0;
+
+    f[n++] = (tune_field){ "simd_rate", &profile.simd_rate };
+    f[n++] = (tune_field){ "stream_rate", &profile.stream_rate };
+    for(int i=0; i < TUNE_NUM_TILES; i++){
+        snprintf(names[i], sizeof(names[i]), "tiled_rate_%d", tune_tiles[i]);
+        f[n++] = (tune_field){ names[i], &profile.tiled_rate[i] };
+    }
+    f[n++] = (tune_field){ "recursive_rate", &profile.recursive_rate };
+    f[n++] = (tune_field){ "pool_sec", &profile.pool_sec };
+    f[n++] = (tune_field){ "cell_spawn_sec", &profile.cell_spawn_sec };
+    f[n++] = (tune_field){ "cell_round_sec", &profile.cell_round_sec };
+    f[n++] = (tune_field){ "closed_sec", &profile.closed_sec };
+
+    return n;
+}
+
+
+static int onlineCpus(){
+
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+    return n > 0 ? (int) n : 1;
+}
+
+
+/** Return the host name (or "localhost" if there is none).*/
+static const char * hostName(){
+
+    static char name[256];
+
+    if(gethostname(name, sizeof(name)) != 0 || name[0] == '\0'){
+        snprintf(name, sizeof(name), "localhost");
+    }
+    name[sizeof(name) - 1] = '\0';
+
+    return name;
+}
+
+
+/** Append s to a file name, with anything but letters, digits, '.' and '-' made '_'.*/
+static void appendSafe(char *buf, size_t size, const char *s){
+
+    size_t len = strlen(buf);
+
+    for(; *s != '\0' && len + 1 < size; s++){
+        buf[len++] = (isalnum((unsigned char) *s) || *s == '.' || *s == '-') ? *s : '_';
+    }
+    buf[len] = '\0';
+}
+
+
+const char * tuneDefaultPath(){
+
+    static char path[1024];
+
+    const char *xdg = getenv("XDG_CACHE_HOME");
+    const char *home = getenv("HOME");
+
+    if(xdg != NULL && xdg[0] != '\0'){
+        snprintf(path, sizeof(path), "%s", xdg);
+    } else if(home != NULL && home[0] != '\0'){
+        snprintf(path, sizeof(path), "%s/.cache", home);
+    } else {
+        snprintf(path, sizeof(path), "/tmp");
+    }
+
+    strncat(path, "/a3", sizeof(path) - strlen(path) - 1);
+
+    strncat(path, "/tune-", sizeof(path) - strlen(path) - 1);
+    appendSafe(path, sizeof(path), hostName());
+    strncat(path, "-", sizeof(path) - strlen(path) - 1);
+    appendSafe(path, sizeof(path), valueTypeName());
+    strncat(path, "-" TUNE_BUILD ".txt", sizeof(path) - strlen(path) - 1);
+
+    return path;
+}
+
+
+/** Read a profile file into the profile.
+ *  @return 0 if it holds a complete profile for this host, or -1 otherwise
+ */
+static int readProfile(const char *path){
+
+    FILE *in = fopen(path, "r");
+    if(in == NULL){
+        return -1;
+    }
+
+    tune_field fields[TUNE_MAX_FIELDS];
+    int num_fields = profileFields(fields);
+    int found = 0, matched = 0;
+
+    char line[512];
+    while(fgets(line, sizeof(line), in) != NULL){
+
+        char key[64], value[384];
+        line[strcspn(line, "\n")] = '\0';
+        if(sscanf(line, "%63s %383[^\n]", key, value) != 2){
+            continue;
+        }
+
+        if(strcmp(key, TUNE_MAGIC) == 0){
+            matched += (atoi(value) == TUNE_VERSION);
+        } else if(strcmp(key, "host") == 0){
+            matched += (strcmp(value, hostName()) == 0);
+        } else if(strcmp(key, "value") == 0){
+            matched += (strcmp(value, valueTypeName()) == 0);
+        } else if(strcmp(key, "build") == 0){
+            matched += (strcmp(value, TUNE_BUILD) == 0);
+        } else if(strcmp(key, "cpus") == 0){
+            profile.cpus = atoi(value);
+            matched += (profile.cpus == onlineCpus());
+        } else {
+
+            for(int i=0; i < num_fields; i++){
+                if(strcmp(key, fields[i].name) == 0){
+                    *fields[i].value = strtod(value, NULL);
+                    found++;
+                }
+            }
+        }
+    }
+
+    fclose(in);
+
+    return (matched == 5 && found == num_fields) ? 0 : -1;
+}
+
+
+/** Make the directories leading to a file, the ones that don't exist yet.*/
+static void makeParents(const char *path){
+
+    char dir[1024];
+    snprintf(dir, sizeof(dir), "%s", path);
+
+    for(char *slash = strchr(dir + 1, '/'); slash != NULL; slash = strchr(slash + 1, '/')){
+        *slash = '\0';
+        mkdir(dir, 0755);
+        *slash = '/';
+    }
+}
+
+
+/** Write the profile to a file. It is written to a temporary file that then replaces the
+ *  old one, so that concurrent readers never see half a profile.
+ *  @return 0 on success, or -1 on failure
+ */
+static int writeProfile(const char *path){
+
+    makeParents(path);
+
+    char tmp[1100];
+    snprintf(tmp, sizeof(tmp), "%s.%ld", path, (long) getpid());
+
+    FILE *out = fopen(tmp, "w");
+    if(out == NULL){
+        return -1;
+    }
+
+    tune_field fields[TUNE_MAX_FIELDS];
+    int num_fields = profileFields(fields);
+
+    fprintf(out, "%s %d\nhost %s\nvalue %s\nbuild %s\ncpus %d\n", TUNE_MAGIC, TUNE_VERSION,
+            hostName(), valueTypeName(), TUNE_BUILD, profile.cpus);
+    for(int i=0; i < num_fields; i++){
+        fprintf(out, "%s %.9g\n", fields[i].name, *fields[i].value);
+    }
+
+    if(fclose(out) != 0 || rename(tmp, path) != 0){
+        remove(tmp);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+/** Run an engine on its own, outside of any context: the calibration can run while a
+ *  context is open, and mustn't use the context's cache.
+ *  @return 0 on success, or an error code
+ */
+static int runEngine(const engine_opts *opts, int rows, int cols, int rounds){
+
+    state_array_t *sa = NULL;
+    int status;
+
+    switch(opts->engine){
+
+        case ENGINE_SIMD:
+            return simdWavefront(rows, cols, rounds, opts);
+
+        case ENGINE_STREAM:
+            return streamWavefront(rows, cols, rounds, opts);
+
+        case ENGINE_TILED:
+            return tiledWavefront(rows, cols, rounds, opts);
+
+        case ENGINE_RECURSIVE:
+            status = recursiveWavefront(&sa, rows, cols, rounds, opts);
+            break;
+
+        default:
+            status = cellWavefront(&sa, rows, cols, rounds, opts);
+            break;
+    }
+
+    destroyStateArray(sa);
+
+    return status;
+}
+
+
+/** Time a run of an engine, recording its rounds rather than printing them.
+ *  @return the time in seconds, or -1 if the engine failed
+ */
+static double timeRun(const engine_opts *opts, int rows, int cols, int rounds){
+
+    value_t values[TUNE_ROUNDS];
+    double times[TUNE_ROUNDS];
+
+    reportRecord(values, times, TUNE_ROUNDS);
+    double start = reportNow();
+    int status = runEngine(opts, rows, cols, rounds);
+    double end = reportNow();
+    reportPrint();
+
+    return status == EXIT_SUCCESS ? end - start : -1;
+}
+
+
+/** Measure an engine configuration.
+ *
+ *  @param first_sec set to the time of a one-round run, startup included
+ *  @param round_sec set to the time of a round
+ *  @return 0 on success, or -1 if the engine failed
+ */
+static int measure(engine_kind engine, int rows, int cols, int threads, int tile,
+                   double *first_sec, double *round_sec){
+
+    engine_opts opts;
+    defaultEngineOpts(&opts);
+    opts.engine = engine;
+    opts.num_threads = threads;
+    opts.tile_rows = tile;
+    opts.tile_cols = tile;
+
+    double one = -1, many = -1;
+    for(int i=0; i < TUNE_REPEATS; i++){
+
+        double t1 = timeRun(&opts, rows, cols, 1);
+        double tn = timeRun(&opts, rows, cols, TUNE_ROUNDS);
+        if(t1 < 0 || tn < 0){
+            return -1;
+        }
+        if(one < 0 || t1 < one) one = t1;
+        if(many < 0 || tn < many) many = tn;
+    }
+
+    // The startup varies from run to run, so the difference can come out too small; the
+    // rounds still take at least their share of the longer run.
+    *first_sec = one;
+    *round_sec = (many - one) / (TUNE_ROUNDS - 1);
+    if(*round_sec < many / TUNE_ROUNDS / 2){
+        *round_sec = many / TUNE_ROUNDS / 2;
+    }
+
+    return 0;
+}
+
+
+/** Measure this host into the profile.
+ *  @return 0 on success, or -1 if an engine failed
+ */
+static int calibrate(){
+
+    double first, round;
+    double cells = (double)(TUNE_GRID - 1) * (TUNE_GRID - 1);
+
+    profile.cpus = onlineCpus();
+
+    if(measure(ENGINE_SIMD, TUNE_GRID, TUNE_GRID, 1, 0, &first, &round) != 0){
+        return -1;
+    }
+    profile.simd_rate = cells / round;
+
+    if(measure(ENGINE_STREAM, TUNE_GRID, TUNE_GRID, 1, 0, &first, &round) != 0){
+        return -1;
+    }
+    profile.stream_rate = cells / round;
+
+    profile.pool_sec = 0;
+    for(int i=0; i < TUNE_NUM_TILES; i++){
+
+        if(measure(ENGINE_TILED, TUNE_GRID, TUNE_GRID, 1, tune_tiles[i], &first, &round) != 0){
+            return -1;
+        }
+        profile.tiled_rate[i] = cells / round;
+        if(i == 0 || first - round < profile.pool_sec){
+            profile.pool_sec = first - round;
+        }
+    }
+
+    if(measure(ENGINE_RECURSIVE, TUNE_GRID, TUNE_GRID, 1, 0, &first, &round) != 0){
+        return -1;
+    }
+    profile.recursive_rate = cells / round;
+
+    double cell_cells = (double)(TUNE_CELL_GRID - 1) * (TUNE_CELL_GRID - 1);
+    if(measure(ENGINE_CELL, TUNE_CELL_GRID, TUNE_CELL_GRID, 0, 0, &first, &round) != 0){
+        return -1;
+    }
+    profile.cell_round_sec = round / cell_cells;
+    profile.cell_spawn_sec = (first > round ? first - round : 0) / cell_cells;
+
+#ifdef STENCIL_DELANNOY
+    // The sum keeps the calls from being optimized away.
+    volatile value_t sink = 0;
+    double start = reportNow();
+    for(int q=0; q < TUNE_CLOSED_REPS; q++){
+        sink = valueAdd3(sink, closedResult(TUNE_CLOSED_SIZE, TUNE_CLOSED_SIZE - q), 0);
+    }
+    profile.closed_sec = (reportNow() - start) / ((double) TUNE_CLOSED_REPS * TUNE_CLOSED_SIZE);
+#else
+    // The closed form is never a candidate for this stencil.
+    profile.closed_sec = 0;
+#endif
+
+    return 0;
+}
+
+
+/** Calibrate this host, once, and save the profile.
+ *  @return 0 on success, or -1 if the calibration failed or the profile couldn't be saved
+ */
+static int calibrateOnce(){
+
+    if(tried_calibration){
+        return have_profile ? 0 : -1;
+    }
+    tried_calibration = 1;
+
+    // A build for one shape (see grid.h) can't run the calibration grids.
+    if(!gridAccepts(TUNE_GRID, TUNE_GRID) || !gridAccepts(TUNE_CELL_GRID, TUNE_CELL_GRID)){
+        return -1;
+    }
+
+    double start = reportNow();
+    if(calibrate() != 0){
+        fprintf(stderr, "auto: calibration failed, using the fallback rule\n");
+        return -1;
+    }
+    have_profile = 1;
+
+    // The profile is still used if it can't be saved, and the next run calibrates again.
+    int status = writeProfile(tune_path);
+    if(tune_explain){
+        fprintf(stderr, "auto: calibrated in %.0f ms, %s %s\n", (reportNow() - start) * 1e3,
+                status == 0 ? "saved to" : "could not save to", tune_path);
+    }
+
+    return status == 0 ? 0 : -1;
+}
+
+
+/** Load the profile if it isn't loaded yet: read the profile file, and if it doesn't hold
+ *  a usable profile, calibrate if may_calibrate is set.
+ *  @return non-zero if there is a profile
+ */
+static int needProfile(int may_calibrate){
+
+    if(have_profile || !tune_set_up){
+        return have_profile;
+    }
+
+    if(!tried_file){
+
+        tried_file = 1;
+        if(readProfile(tune_path) == 0){
+
+            have_profile = 1;
+            if(tune_explain){
+                fprintf(stderr, "auto: using the profile in %s\n", tune_path);
+            }
+            return 1;
+        }
+    }
+
+    if(may_calibrate){
+        calibrateOnce();
+    }
+
+    return have_profile;
+}
+
+
+int tuneLoad(const char *path, int recalibrate, int explain){
+
+    snprintf(tune_path, sizeof(tune_path), "%s", path != NULL ? path : tuneDefaultPath());
+    tune_explain = explain;
+    tune_set_up = 1;
+
+    if(recalibrate){
+        tried_file = 1;
+        return calibrateOnce();
+    }
+
+    return 0;
+}
+
+
+/** Return the measured rate of the tiled engine for the tile size nearest to this one.*/
+static double tiledRate(int tile_rows, int tile_cols){
+
+    int size = tile_rows > tile_cols ? tile_rows : tile_cols;
+    int nearest = 0;
+
+    for(int i=1; i < TUNE_NUM_TILES; i++){
+        if(abs(tune_tiles[i] - size) < abs(tune_tiles[nearest] - size)){
+            nearest = i;
+        }
+    }
+
+    return profile.tiled_rate[nearest];
+}
+
+
+/** Estimate a pool engine's time for a query (see tune.h).*/
+static double poolEstimate(double rate, int threads, int tile_rows, int tile_cols,
+                           int num_state_rows, int num_state_cols, int numRounds){
+
+    double cells = (double)(num_state_rows - 1) * (num_state_cols - 1);
+    int tr = (num_state_rows - 2) / tile_rows + 1;
+    int tc = (num_state_cols - 2) / tile_cols + 1;
+
+    double speedup = (double) tr * tc / (tr + tc - 1);
+    if(speedup > threads) speedup = threads;
+    if(speedup > profile.cpus) speedup = profile.cpus;
+    if(speedup < 1) speedup = 1;
+
+    return profile.pool_sec * threads + numRounds * cells / (rate * speedup);
+}
+
+
+/** Add the best configuration of a pool engine to the candidates. The thread count and the
+ *  tile size are tried over their range, unless opts sets them.
+ */
+static void addPoolCandidate(tune_choice *choice, engine_kind engine, const engine_opts *opts,
+                             int num_state_rows, int num_state_cols, int numRounds){
+
+    tune_candidate *cand = &choice->candidates[choice->num_candidates++];
+    cand->engine = engine;
+    cand->est_sec = -1;
+    cand->why_not = NULL;
+
+    int min_threads = opts->num_threads > 0 ? opts->num_threads : 1;
+    int max_threads = opts->num_threads > 0 ? opts->num_threads : profile.cpus;
+
+    // The recursive engine was only measured with its default leaves.
+    int sizes[TUNE_NUM_TILES];
+    int num_sizes = 0;
+    if(opts->tile_rows > 0){
+        sizes[num_sizes++] = opts->tile_rows;
+    } else if(engine == ENGINE_RECURSIVE){
+        sizes[num_sizes++] = RECURSIVE_LEAF_SIZE;
+    } else {
+        for(int i=0; i < TUNE_NUM_TILES; i++){
+            sizes[num_sizes++] = tune_tiles[i];
+        }
+    }
+
+    for(int s=0; s < num_sizes; s++){
+
+        int tile_rows = sizes[s];
+        int tile_cols = opts->tile_cols > 0 ? opts->tile_cols : tile_rows;
+        double rate = engine == ENGINE_TILED ? tiledRate(tile_rows, tile_cols)
+                                             : profile.recursive_rate;
+
+        for(int t=min_threads; t <= max_threads; t++){
+
+            double est = poolEstimate(rate, t, tile_rows, tile_cols, num_state_rows,
+                                      num_state_cols, numRounds);
+            if(cand->est_sec < 0 || est < cand->est_sec){
+                cand->est_sec = est;
+                cand->num_threads = t;
+                cand->tile_size = tile_rows;
+            }
+        }
+    }
+}
+
+
+/** Add a serial engine to the candidates, with its estimate or why it isn't considered.*/
+static void addCandidate(tune_choice *choice, engine_kind engine, double est_sec,
+                         const char *why_not){
+
+    tune_candidate *cand = &choice->candidates[choice->num_candidates++];
+    cand->engine = engine;
+    cand->num_threads = 1;
+    cand->tile_size = 0;
+    cand->est_sec = why_not == NULL ? est_sec : -1;
+    cand->why_not = why_not;
+}
+
+
+void tuneChoose(int num_state_rows, int num_state_cols, int numRounds, int full,
+                const engine_opts *opts, tune_choice *choice){
+
+    double cells = (double)(num_state_rows - 1) * (num_state_cols - 1);
+    int min_dim = num_state_rows < num_state_cols ? num_state_rows : num_state_cols;
+
+    // The cell engine is the fallback for grids it can run, so a small query only uses a
+    // profile that is already at hand, and never waits for the calibration.
+    int have = needProfile(cells > CELL_ENGINE_MAX_CELLS);
+
+    choice->full = full;
+    choice->calibrated = have;
+    choice->num_candidates = 0;
+    choice->best = -1;
+    choice->num_threads = opts->num_threads;
+    choice->tile_rows = opts->tile_rows;
+    choice->tile_cols = opts->tile_cols;
+
+    if(!have){
+        choice->engine = (cells > CELL_ENGINE_MAX_CELLS) ? ENGINE_TILED : ENGINE_CELL;
+        return;
+    }
+
+    const char *not_full = full ? "only computes element 0, and the query needs them all"
+                                : NULL;
+
+#ifdef STENCIL_DELANNOY
+    const char *not_closed = not_full;
+#else
+    const char *not_closed = "the " STENCIL_NAME " stencil has no closed form";
+#endif
+
+    addCandidate(choice, ENGINE_CLOSED, numRounds * min_dim * profile.closed_sec, not_closed);
+    addCandidate(choice, ENGINE_SIMD, numRounds * cells / profile.simd_rate, not_full);
+    addCandidate(choice, ENGINE_STREAM, numRounds * cells / profile.stream_rate, not_full);
+    addCandidate(choice, ENGINE_CELL,
+                 cells * (profile.cell_spawn_sec + numRounds * profile.cell_round_sec),
+                 cells > CELL_ENGINE_MAX_CELLS ? "would need more threads than "
+                                                 "CELL_ENGINE_MAX_CELLS" : NULL);
+    addPoolCandidate(choice, ENGINE_TILED, opts, num_state_rows, num_state_cols, numRounds);
+    addPoolCandidate(choice, ENGINE_RECURSIVE, opts, num_state_rows, num_state_cols,
+                     numRounds);
+
+    for(int i=0; i < choice->num_candidates; i++){
+
+        const tune_candidate *cand = &choice->candidates[i];
+        if(cand->est_sec >= 0 &&
+           (choice->best < 0 || cand->est_sec < choice->candidates[choice->best].est_sec)){
+            choice->best = i;
+        }
+    }
+
+    const tune_candidate *best = &choice->candidates[choice->best];
+    choice->engine = best->engine;
+    if(best->tile_size > 0){
+        choice->num_threads = best->num_threads;
+        choice->tile_rows = best->tile_size;
+        choice->tile_cols = opts->tile_cols > 0 ? opts->tile_cols : best->tile_size;
+    }
+}
+
+
+void tuneExplain(FILE *out, int num_state_rows, int num_state_cols, int numRounds,
+                 const tune_choice *choice){
+
+    fprintf(out, "auto: %d x %d, %d round%s, %s, %s\n", num_state_rows, num_state_cols,
+            numRounds, numRounds == 1 ? "" : "s",
+            choice->full ? "every element needed" : "element 0 only", valueTypeName());
+
+    if(!choice->calibrated){
+        fprintf(out, "auto: no profile, so %s (%s %d interior elements)\n",
+                engineName(choice->engine),
+                choice->engine == ENGINE_TILED ? "more than" : "at most",
+                CELL_ENGINE_MAX_CELLS);
+        return;
+    }
+
+    for(int i=0; i < choice->num_candidates; i++){
+
+        const tune_candidate *cand = &choice->candidates[i];
+        fprintf(out, "auto:   %-10s", engineName(cand->engine));
+
+        if(cand->est_sec < 0){
+            fprintf(out, " not considered: %s\n", cand->why_not);
+            continue;
+        }
+
+        fprintf(out, " %12.3f ms", cand->est_sec * 1e3);
+        if(cand->tile_size > 0){
+            fprintf(out, "  (%d of %d CPUs, %s of %d)", cand->num_threads, profile.cpus,
+                    cand->engine == ENGINE_TILED ? "tiles" : "leaves", cand->tile_size);
+        }
+        fprintf(out, "%s\n", i == choice->best ? "  <- fastest" : "");
+    }
+
+    fprintf(out, "auto: chose %s", engineName(choice->engine));
+    if(choice->candidates[choice->best].tile_size > 0){
+        fprintf(out, " with %d thread%s and %d x %d %s", choice->num_threads,
+                choice->num_threads == 1 ? "" : "s", choice->tile_rows, choice->tile_cols,
+                choice->engine == ENGINE_TILED ? "tiles" : "leaves");
+    }
+    fprintf(out, "\n");
+}
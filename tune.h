@@ -0,0 +1,101 @@
+#ifndef TUNE_H
+#define TUNE_H
+
+#include <stdio.h>
+
+#include "wavefront.h"
+
+/*
+ * tune.h
+ *
+ * The choices of the "auto" engine. A query is run on whichever engine, thread count, and
+ * tile size is estimated to finish it first, from a profile of this host: the rate at
+ * which each engine computes elements on one thread, the cost of starting a pool and of a
+ * thread per element, and the cost of a term of the closed form. The profile is measured
+ * by a calibration run of a fraction of a second, and kept in a small text file per host
+ * and value type, so that only the first run on a host pays for it. The calibration only
+ * runs when a query needs the profile: queries small enough for the cell engine, which is
+ * also the fallback for them, use the profile file if there is one, and otherwise the
+ * fallback rule.
+ *
+ * The estimate for an engine is its startup cost plus rounds * elements / rate. The pool
+ * engines (tiled and recursive) divide the rate by the speedup they can get from their
+ * threads, which is at most the number of threads, the number of CPUs, and the average
+ * number of tiles on an anti-diagonal of tiles (the tiles, over the diagonals they take).
+ *
+ * Queries that need the sum of every element (batches and grid files) only consider the
+ * engines that fill in the state array. The GPU engine is only used when it is selected.
+ */
+
+// The tile sizes the calibration measures for the tiled engine.
+#define TUNE_NUM_TILES 4
+#define TUNE_TILES { 16, 32, 64, 128 }
+
+// The most configurations tuneChoose() compares.
+#define TUNE_MAX_CANDIDATES 8
+
+// What the tuner estimated for one configuration.
+typedef struct{
+
+    engine_kind engine;
+    int num_threads;        // the pool's threads (1 for the serial engines)
+    int tile_size;          // the tile or leaf size of a pool engine, or 0
+    double est_sec;         // the estimated time of the query, or < 0 if not considered
+    const char *why_not;    // if not considered, the reason
+} tune_candidate;
+
+// What the tuner chose for a query, and the alternatives it compared.
+typedef struct{
+
+    engine_kind engine;
+    int num_threads;
+    int tile_rows, tile_cols;
+
+    int full;               // the query needs the sum of every element
+    int calibrated;         // the choice came from a profile, not the fallback rule
+    tune_candidate candidates[TUNE_MAX_CANDIDATES];
+    int num_candidates;
+    int best;               // the index of the chosen candidate, or -1
+} tune_choice;
+
+
+/** Set up the profile of this host. The first query that needs it reads the profile file,
+ *  and calibrates and saves it if there is no usable profile there (or it was made for a
+ *  different host, value type, build, or number of CPUs). Until this is called (or in a
+ *  build for one grid shape, see grid.h), tuneChoose() falls back to running small grids
+ *  on the cell engine and larger ones on the tiled engine.
+ *
+ *  @param path the profile file, or NULL for the default (see tuneDefaultPath())
+ *  @param recalibrate non-zero to calibrate now, even if the file holds a usable profile
+ *  @param explain non-zero to print where the profile came from, and whether it could be
+ *      saved, to stderr
+ *  @return 0 on success, or -1 if the recalibration failed or its profile couldn't be
+ *      saved (it is still used)
+ */
+int tuneLoad(const char *path, int recalibrate, int explain);
+
+/** Return the default profile file, $XDG_CACHE_HOME/a3/tune-HOST-VALUETYPE-BUILD.txt (or
+ *  the same under ~/.cache). Its directory is made when a profile is saved. The string is
+ *  static.
+ */
+const char * tuneDefaultPath();
+
+/** Choose the engine, thread count, and tile size for a query. A thread count or tile
+ *  size set in opts is kept, and only the other choices are made.
+ *
+ *  @param num_state_rows number of rows in the state array
+ *  @param num_state_cols number of columns in the state array
+ *  @param numRounds number of rounds to run
+ *  @param full non-zero if the query needs the sum of every element
+ *  @param opts the options of the query
+ *  @param choice set to the choice
+ */
+void tuneChoose(int num_state_rows, int num_state_cols, int numRounds, int full,
+                const engine_opts *opts, tune_choice *choice);
+
+/** Print a choice, with the estimate for each alternative or why it wasn't considered.*/
+void tuneExplain(FILE *out, int num_state_rows, int num_state_cols, int numRounds,
+                 const tune_choice *choice);
+
+
+#endif
@@ -0,0 +1,45 @@
+#include <stdio.h>
+
+#include "value.h"
+
+
+char * valueToString(value_t v, char *buf){
+
+#if defined(VALUE_INT128)
+    // printf() has no conversion for 128-bit integers, so peel off the digits by hand.
+    char digits[VALUE_STR_LEN];
+    int n = 0;
+
+    do{
+        digits[n++] = (char)('0' + (int)(v % 10));
+        v /= 10;
+    } while(v != 0);
+
+    for(int i=0; i < n; i++){
+        buf[i] = digits[n - 1 - i];
+    }
+    buf[n] = '\0';
+#elif defined(VALUE_INT64)
+    snprintf(buf, VALUE_STR_LEN, "%lld", (long long) v);
+#elif defined(VALUE_MOD)
+    snprintf(buf, VALUE_STR_LEN, "%llu", (unsigned long long) v);
+#else
+    snprintf(buf, VALUE_STR_LEN, "%d", (int) v);
+#endif
+
+    return buf;
+}
+
+
+const char * valueTypeName(){
+
+#if defined(VALUE_MOD)
+    static char name[VALUE_STR_LEN];
+    if(name[0] == '\0'){
+        snprintf(name, sizeof(name), "mod %llu", (unsigned long long) VALUE_MODULUS);
+    }
+    return name;
+#else
+    return VALUE_TYPE_NAME;
+#endif
+}
@@ -0,0 +1,100 @@
+#ifndef VALUE_H
+#define VALUE_H
+
+/*
+ * value.h
+ *
+ * The type of the sum stored in each state array element. The sums grow like the
+ * Delannoy numbers, so a 32-bit int overflows past about a 17 x 17 array. The type is
+ * chosen at compile time:
+ *
+ *      (default)       int32: sums wrap around modulo 2^32, like the original code
+ *      -DVALUE_INT64   int64: sums wrap around modulo 2^64
+ *      -DVALUE_INT128  unsigned __int128: sums wrap around modulo 2^128
+ *      -DVALUE_MOD     sums are reduced modulo VALUE_MODULUS (default 10^9 + 7)
+ *
+ * Wraparound is done in unsigned arithmetic, so it is well defined for the signed types.
+ * Readiness is tracked by the epochs in the sync plane, so any value (including 0) is a
+ * valid sum.
+ */
+#include <stdint.h>
+
+
+#if defined(VALUE_INT64)
+
+typedef int64_t value_t;
+typedef uint64_t uvalue_t;
+#define VALUE_TYPE_NAME "int64"
+#define VALUE_BITS 64
+
+#elif defined(VALUE_INT128)
+
+__extension__ typedef unsigned __int128 value_t;
+__extension__ typedef unsigned __int128 uvalue_t;
+#define VALUE_TYPE_NAME "uint128"
+#define VALUE_BITS 128
+
+#elif defined(VALUE_MOD)
+
+#ifndef VALUE_MODULUS
+#define VALUE_MODULUS 1000000007ULL
+#endif
+
+// The modulus must leave room for the sum of two reduced values in 64 bits. (This header is
+// also included by the CUDA engine, which is C++.)
+#ifdef __cplusplus
+static_assert(VALUE_MODULUS > 1 && VALUE_MODULUS < (1ULL << 62), "VALUE_MODULUS out of range");
+#else
+_Static_assert(VALUE_MODULUS > 1 && VALUE_MODULUS < (1ULL << 62), "VALUE_MODULUS out of range");
+#endif
+
+typedef uint64_t value_t;
+typedef uint64_t uvalue_t;
+#define VALUE_TYPE_NAME "mod"
+#define VALUE_BITS 64
+
+#else
+
+typedef int32_t value_t;
+typedef uint32_t uvalue_t;
+#define VALUE_TYPE_NAME "int32"
+#define VALUE_BITS 32
+
+#endif
+
+// The value of a border element.
+#define VALUE_ONE ((value_t) 1)
+
+// Enough room for the decimal digits of any value_t, plus a sign and the terminator.
+#define VALUE_STR_LEN 48
+
+
+/** Return the sum of three values in the selected arithmetic.*/
+#ifdef __CUDACC__
+__host__ __device__
+#endif
+static inline value_t valueAdd3(value_t a, value_t b, value_t c){
+
+#if defined(VALUE_MOD)
+    value_t s = a + b;
+    if(s >= VALUE_MODULUS) s -= VALUE_MODULUS;
+    s += c;
+    if(s >= VALUE_MODULUS) s -= VALUE_MODULUS;
+    return s;
+#else
+    return (value_t)((uvalue_t) a + (uvalue_t) b + (uvalue_t) c);
+#endif
+}
+
+/** Write the decimal form of a value into buf, which must hold VALUE_STR_LEN characters.
+ *  @return buf
+ */
+char * valueToString(value_t v, char *buf);
+
+/** Return a description of the selected value type, such as "int64" or "mod 1000000007".
+ *  The string is statically allocated.
+ */
+const char * valueTypeName();
+
+
+#endif
@@ -0,0 +1,161 @@
+#ifndef WAVEFRONT_H
+#define WAVEFRONT_H
+
+#include "barrier.h"
+#include "value.h"
+#include "grid_file.h"
+
+// See state_array.h. Declared here too so this header doesn't pull in the state array.
+typedef struct state_array state_array_t;
+
+// The execution engines that can run a wavefront computation. All engines produce the
+// same "Round r, result is X" output; they differ only in how the work is scheduled.
+typedef enum{
+
+    ENGINE_AUTO,    // pick an engine, threads, and tiles from the grid shape (see tune.h)
+    ENGINE_CELL,    // one pthread per interior cell (the original doWork() engine)
+    ENGINE_PIPELINE,// one pthread per interior cell, with no barrier between rounds
+    ENGINE_TILED,   // a fixed pool of workers processing rectangular tiles
+    ENGINE_RECURSIVE, // a pool of workers splitting the grid into quadrants (see recursive.h)
+    ENGINE_SIMD,    // a single thread sweeping anti-diagonals with vector adds
+    ENGINE_STREAM,  // a single thread sweeping rows, in O(min(rows, cols)) memory
+    ENGINE_CLOSED,  // no wavefront: the closed form of the result (see closed.h)
+#ifdef WF_GPU
+    ENGINE_GPU,     // the anti-diagonal sweep on a CUDA device (see gpu.h)
+#endif
+
+    ENGINE_COUNT    // number of engines; not an engine
+} engine_kind;
+
+// Options shared by all engines. A value of 0 means "use the default".
+typedef struct{
+
+    engine_kind engine;
+    int num_threads;    // size of the worker pool (default: number of online cores)
+    int tile_rows;      // rows of state array elements per tile
+    int tile_cols;      // columns of state array elements per tile
+    int stats;          // if non-zero, print per-worker scheduler stats to stderr
+    barrier_kind barrier; // the barrier implementation used between rounds
+    int affinity;       // if non-zero, pin threads and first-touch rows per node (see affinity.h)
+    int cache;          // if non-zero, a context memoizes results by shape (see cache.h)
+    const char *cache_file; // with cache, the file shared between processes (NULL: in memory)
+    int groups;         // tiled rounds run concurrently on this many worker groups (see groups.h);
+                        // more than 1 needs the tiled or auto engine, and auto then runs tiled
+    const char *grid_file; // if set, a context writes each query's final sums here (see grid_file.h)
+    grid_layout layout; // the order of the sums in grid_file
+    int explain;        // if non-zero, print what the auto engine chose for each query and why
+} engine_opts;
+
+// The auto engine never runs grids with more interior cells than this on the per-cell
+// engine, since it would need one thread for each of them (see tune.h).
+#define CELL_ENGINE_MAX_CELLS 1024
+
+#define DEFAULT_TILE_SIZE 32
+
+// The most rounds a query can run. Round r publishes epoch r + 1, which must stay below the
+// epoch of the border elements (BORDER_EPOCH in state_array.h) and the waiter bit of an
+// epoch word (see futex.h), and so must the barriers' cycle numbers.
+#define WAVEFRONT_MAX_ROUNDS 0x3ffffffe
+
+
+/** Fill in an engine_opts struct with the default values.
+ *
+ *  @param opts the options to initialize
+ */
+void defaultEngineOpts(engine_opts *opts);
+
+/** Return the name of an engine, as accepted on the command line.*/
+const char * engineName(engine_kind engine);
+
+/** Look up an engine by name.
+ *
+ *  @param name the name of the engine
+ *  @param engine set to the engine, if one has that name
+ *  @return 0 on success, or -1 if there is no such engine
+ */
+int engineFromName(const char *name, engine_kind *engine);
+
+/** Run the specified number of rounds of a wavefront computation on the engine selected
+ *  in opts, printing the result of each round.
+ *
+ *  @param num_state_rows number of rows in the state array
+ *  @param num_state_cols number of columns in the state array
+ *  @param numRounds number of rounds to repeat
+ *  @param opts the engine options
+ *  @return 0 on success, or an error code
+ */
+int wavefront(int num_state_rows, int num_state_cols, int numRounds, const engine_opts *opts);
+
+// A persistent wavefront service. A context keeps the tiled engine's worker pool and a
+// state array alive between computations, so a series of queries of different shapes
+// only pays for the computation itself. The other engines are run as by wavefront().
+// With the cache option, a shape that has been computed before isn't computed again.
+// Only one context may exist at a time, because the result cache and the output of the
+// rounds are kept per process: wavefrontContextCreate() fails while another one is open,
+// and so does wavefront(), which runs in a context of its own.
+typedef struct wavefront_context wavefront_context;
+
+/** Create a context for grids of up to max_rows x max_cols. Larger grids are still
+ *  accepted, and grow the state array.
+ *
+ *  @param max_rows number of rows in the largest expected state array
+ *  @param max_cols number of columns in the largest expected state array
+ *  @param opts the engine options, used for every query
+ *  @return the new context, or NULL on failure (or if another context is open, or opts
+ *      asks for more than one group on an engine other than tiled or auto)
+ */
+wavefront_context * wavefrontContextCreate(int max_rows, int max_cols, const engine_opts *opts);
+
+/** Run the specified number of rounds of a wavefront computation in a context, printing
+ *  the result of each round.
+ *
+ *  The output of the rounds is flushed before returning (see reportFlush()); in the summary
+ *  mode, a round that disagrees with round 0 makes the query fail.
+ *
+ *  With the grid_file option, the final sums of the whole array are written to that file
+ *  (see grid_file.h). The query then runs on an engine that fills in the state array, as
+ *  in wavefrontBatch(), and isn't answered from the cache.
+ *
+ *  @param ctx the context
+ *  @param num_state_rows number of rows in the state array, at least 1
+ *  @param num_state_cols number of columns in the state array, at least 1
+ *  @param numRounds number of rounds to repeat, 0 .. WAVEFRONT_MAX_ROUNDS
+ *  @param result if not NULL, set to the result of the last round
+ *  @return 0 on success, or an error code
+ */
+int wavefrontRun(wavefront_context *ctx, int num_state_rows, int num_state_cols, int numRounds,
+                 value_t *result);
+
+/** Answer many queries with a single sweep. Element (i, j) of an R x C state array holds
+ *  the result of an (R - i) x (C - j) computation, so one round at the largest number of
+ *  rows and columns among the queries answers all of them. The sweep runs on the
+ *  context's engine if it fills in the state array (cell, pipeline, tiled, or recursive),
+ *  and on the tiled engine otherwise. With the closed engine, each query is answered on
+ *  its own with closedResult() instead. Nothing is printed.
+ *
+ *  @param ctx the context
+ *  @param rows the number of rows in each query
+ *  @param cols the number of columns in each query
+ *  @param n the number of queries
+ *  @param results set to the result of each query
+ *  @return 0 on success, or an error code
+ */
+int wavefrontBatch(wavefront_context *ctx, const int *rows, const int *cols, int n,
+                   value_t *results);
+
+/** Stop the workers of a context and free it.
+ *  @return 0 on success, or an error code
+ */
+int wavefrontContextDestroy(wavefront_context *ctx);
+
+/** Run the wavefront computation with one thread per interior cell of the state array,
+ *  either with a barrier between rounds or, for ENGINE_PIPELINE, with the rounds
+ *  pipelined. The array in *sa is reused if it is big enough, and replaced otherwise, so
+ *  *sa holds the array of this computation on return. See wavefront() for the other
+ *  parameters.
+ */
+int cellWavefront(state_array_t **sa, int num_state_rows, int num_state_cols, int numRounds,
+                  const engine_opts *opts);
+
+
+#endif
@@ -0,0 +1,271 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <sched.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "wspool.h"
+
+/** The deques are circular buffers guarded by a mutex. The owner only touches the bottom
+ *  and thieves only touch the top, so the lock is almost never contended: it is taken by
+ *  two threads only when a thief arrives at a deque its owner is working on.
+ */
+
+
+
+// A worker's deque and counters. Each worker gets its own cache line(s), so that the
+// owner's pushes and pops don't invalidate the lines of other workers.
+typedef struct{
+
+    _Alignas(64) pthread_mutex_t lock;
+    int *tasks;             // circular buffer of max_tasks entries
+    int top;                // next task to steal
+    int count;              // number of tasks in the deque
+    unsigned int seed;      // for picking steal victims
+
+    wspool_stats stats;
+} wspool_worker;
+
+
+struct wspool{
+
+    int num_workers;
+    int max_tasks;
+    wspool_task_fn fn;
+    void *ctx;
+
+    atomic_int pending;     // tasks announced but not yet completed
+    wspool_worker *workers;
+};
+
+
+
+wspool * wspoolCreate(int num_workers, int max_tasks, wspool_task_fn fn, void *ctx){
+
+    wspool *pool = malloc(sizeof(wspool));
+    if(pool == NULL){
+        return NULL;
+    }
+
+    pool->num_workers = num_workers;
+    pool->max_tasks = max_tasks > 0 ? max_tasks : 1;
+    pool->fn = fn;
+    pool->ctx = ctx;
+    atomic_init(&pool->pending, 0);
+
+    pool->workers = aligned_alloc(64, num_workers * sizeof(wspool_worker));
+
+    for(int i=0; i < num_workers; i++){
+
+        wspool_worker *w = &pool->workers[i];
+
+        pthread_mutex_init(&w->lock, NULL);
+        w->tasks = malloc(pool->max_tasks * sizeof(int));
+        w->top = 0;
+        w->count = 0;
+        w->seed = 2654435761u * (i + 1);
+
+        w->stats.tasks = 0;
+        w->stats.steals = 0;
+        w->stats.failed_steals = 0;
+        w->stats.idle_sec = 0.0;
+    }
+
+    return pool;
+}
+
+
+void wspoolDestroy(wspool *pool){
+
+    for(int i=0; i < pool->num_workers; i++){
+
+        pthread_mutex_destroy(&pool->workers[i].lock);
+        free(pool->workers[i].tasks);
+    }
+
+    free(pool->workers);
+    free(pool);
+}
+
+
+int wspoolReserve(wspool *pool, int max_tasks){
+
+    if(max_tasks <= pool->max_tasks){
+        return 0;
+    }
+
+    for(int i=0; i < pool->num_workers; i++){
+
+        // The deques are empty between rounds, so the contents don't need to be kept.
+        int *tasks = malloc(max_tasks * sizeof(int));
+        if(tasks == NULL){
+            return -1;
+        }
+        free(pool->workers[i].tasks);
+        pool->workers[i].tasks = tasks;
+        pool->workers[i].top = 0;
+        pool->workers[i].count = 0;
+    }
+
+    pool->max_tasks = max_tasks;
+
+    return 0;
+}
+
+
+void wspoolBegin(wspool *pool, int num_tasks){
+
+    atomic_store(&pool->pending, num_tasks);
+}
+
+
+void wspoolPush(wspool *pool, int worker, int task){
+
+    wspool_worker *w = &pool->workers[worker];
+
+    pthread_mutex_lock(&w->lock);
+    w->tasks[(w->top + w->count) % pool->max_tasks] = task;
+    w->count++;
+    pthread_mutex_unlock(&w->lock);
+}
+
+
+/** Pop the most recently pushed task from the bottom of a worker's own deque.
+ *  @return the task, or -1 if the deque is empty
+ */
+static int popBottom(wspool *pool, wspool_worker *w){
+
+    int task = -1;
+
+    pthread_mutex_lock(&w->lock);
+    if(w->count > 0){
+        w->count--;
+        task = w->tasks[(w->top + w->count) % pool->max_tasks];
+    }
+    pthread_mutex_unlock(&w->lock);
+
+    return task;
+}
+
+
+/** Take the oldest task from the top of a victim's deque.
+ *  @return the task, or -1 if the deque is empty
+ */
+static int stealTop(wspool *pool, wspool_worker *victim){
+
+    int task = -1;
+
+    pthread_mutex_lock(&victim->lock);
+    if(victim->count > 0){
+        task = victim->tasks[victim->top];
+        victim->top = (victim->top + 1) % pool->max_tasks;
+        victim->count--;
+    }
+    pthread_mutex_unlock(&victim->lock);
+
+    return task;
+}
+
+
+/** Visit every other worker once, starting at a random one, and steal the first task
+ *  found.
+ *  @return the task, or -1 if all deques were empty
+ */
+static int steal(wspool *pool, int worker){
+
+    wspool_worker *self = &pool->workers[worker];
+    int n = pool->num_workers;
+
+    if(n < 2){
+        return -1;
+    }
+
+    self->seed = self->seed * 1103515245u + 12345u;
+    int start = (int)((self->seed >> 16) % (unsigned int) n);
+
+    for(int i=0; i < n; i++){
+
+        int v = (start + i) % n;
+        if(v == worker){
+            continue;
+        }
+
+        int task = stealTop(pool, &pool->workers[v]);
+        if(task >= 0){
+            self->stats.steals++;
+            return task;
+        }
+    }
+
+    self->stats.failed_steals++;
+    return -1;
+}
+
+
+static double now(){
+
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+void wspoolRun(wspool *pool, int worker){
+
+    wspool_worker *self = &pool->workers[worker];
+    double idle_start = 0.0;
+
+    while(atomic_load_explicit(&pool->pending, memory_order_acquire) > 0){
+
+        int task = popBottom(pool, self);
+        if(task < 0){
+            task = steal(pool, worker);
+        }
+
+        if(task < 0){
+
+            // Nothing to do until some other worker finishes a task. Give up the core,
+            // since that worker may be waiting for it.
+            if(idle_start == 0.0){
+                idle_start = now();
+            }
+            sched_yield();
+            continue;
+        }
+
+        if(idle_start != 0.0){
+            self->stats.idle_sec += now() - idle_start;
+            idle_start = 0.0;
+        }
+
+        pool->fn(pool, worker, task, pool->ctx);
+        self->stats.tasks++;
+
+        atomic_fetch_sub_explicit(&pool->pending, 1, memory_order_acq_rel);
+    }
+
+    if(idle_start != 0.0){
+        self->stats.idle_sec += now() - idle_start;
+    }
+}
+
+
+const wspool_stats * wspoolStats(const wspool *pool, int worker){
+
+    return &pool->workers[worker].stats;
+}
+
+
+void wspoolPrintStats(const wspool *pool, FILE *out){
+
+    for(int i=0; i < pool->num_workers; i++){
+
+        const wspool_stats *s = &pool->workers[i].stats;
+        fprintf(out, "worker %d: tasks %ld, steals %ld, failed steals %ld, idle %.3f ms\n",
+                i, s->tasks, s->steals, s->failed_steals, s->idle_sec * 1e3);
+    }
+}
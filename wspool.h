@@ -0,0 +1,82 @@
+#ifndef WSPOOL_H
+#define WSPOOL_H
+
+/*
+ * wspool.h
+ *
+ * A work-stealing scheduler for a fixed set of worker threads. Each worker owns a deque
+ * of ready tasks. A worker pushes and pops tasks at the bottom of its own deque, and when
+ * the deque is empty it steals from the top of another worker's deque.
+ *
+ * Tasks are plain integers (tile numbers, for example) that are handed to the task
+ * function given at creation time. The task function may push new tasks as it discovers
+ * them. The pool doesn't create threads itself: the caller runs wspoolRun() on each of its
+ * own threads, passing a distinct worker number.
+ */
+#include <stdio.h>
+
+
+// Counters kept by each worker, for reporting.
+typedef struct{
+
+    long tasks;             // tasks executed
+    long steals;            // tasks taken from another worker's deque
+    long failed_steals;     // passes over all other deques that found nothing
+    double idle_sec;        // time spent with no task to execute
+} wspool_stats;
+
+typedef struct wspool wspool;
+
+// A task function. It is passed the pool, the number of the worker running it, the task,
+// and the context pointer given to wspoolCreate().
+typedef void (* wspool_task_fn)(wspool *pool, int worker, int task, void *ctx);
+
+
+/** Create a pool for the given number of workers.
+ *
+ *  @param num_workers the number of workers that will call wspoolRun()
+ *  @param max_tasks an upper bound on the number of tasks ready at the same time
+ *  @param fn the task function
+ *  @param ctx a pointer passed to every call of the task function
+ *  @return the new pool, or NULL on failure
+ */
+wspool * wspoolCreate(int num_workers, int max_tasks, wspool_task_fn fn, void *ctx);
+
+/** Make room for max_tasks ready tasks in each deque. Only call this between rounds, while
+ *  no worker is in wspoolRun(). The counters are kept.
+ *
+ *  @return 0 on success, or -1 if the memory couldn't be allocated
+ */
+int wspoolReserve(wspool *pool, int max_tasks);
+
+/** Free a pool. No worker may be running.*/
+void wspoolDestroy(wspool *pool);
+
+/** Announce that the given number of tasks will be executed before the pool is drained.
+ *  Must be called before the workers call wspoolRun().
+ */
+void wspoolBegin(wspool *pool, int num_tasks);
+
+/** Push a ready task onto a worker's deque.
+ *
+ *  @param pool the pool
+ *  @param worker the worker whose deque receives the task
+ *  @param task the task
+ */
+void wspoolPush(wspool *pool, int worker, int task);
+
+/** Execute tasks until all of the tasks announced by wspoolBegin() have completed.
+ *
+ *  @param pool the pool
+ *  @param worker the number of the calling worker, from 0 to num_workers-1
+ */
+void wspoolRun(wspool *pool, int worker);
+
+/** Return the counters of a worker.*/
+const wspool_stats * wspoolStats(const wspool *pool, int worker);
+
+/** Print the counters of every worker to the given stream.*/
+void wspoolPrintStats(const wspool *pool, FILE *out);
+
+
+#endif